@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/*
+ * Allocates objects of type T from large chunks instead of one by one from
+ * the heap.  This saves the bookkeeping of the general purpose allocator for
+ * every object, and objects allocated one after the other end up next to each
+ * other in memory (in creation order, as long as nothing has been freed).
+ * Freed slots are kept on a free list and reused first.  The first chunk is
+ * small and every further one twice as large (up to a limit), so an arena
+ * that only holds a few objects stays small.
+ *
+ * Releasing the arena frees the chunks without running the destructors of
+ * the objects that are still allocated, so T must not own any resources.
+ * Objects are constructed by the caller with placement new in the memory
+ * returned by Allocate(), so T may have private constructors.
+ */
+template <typename T>
+class Arena {
+  public:
+    Arena() : chunk_size_(0), used_(0), free_(nullptr), size_(0) {}
+
+    Arena(const Arena &) = delete;
+    Arena& operator=(const Arena &) = delete;
+
+    ~Arena() {
+      for (auto chunk : chunks_) {
+        ::operator delete(chunk);
+      }
+    }
+
+    /* Uninitialized memory for one T. */
+    void* Allocate() {
+      ++size_;
+      if (free_ != nullptr) {
+        Slot *slot = free_;
+        free_ = slot->next;
+        return slot;
+      }
+      if (used_ == chunk_size_) {
+        chunk_size_ = chunk_size_ == 0 ? kMinChunkSize() : std::min(2 * chunk_size_, kMaxChunkSize());
+        chunks_.push_back(static_cast<Slot*>(::operator new(chunk_size_ * sizeof(Slot))));
+        used_ = 0;
+      }
+      return &chunks_.back()[used_++];
+    }
+
+    /* Destroys the object and puts its slot on the free list. */
+    void Free(const T *object) {
+      assert(size_ > 0);
+      --size_;
+      object->~T();
+      Slot *slot = reinterpret_cast<Slot*>(const_cast<T*>(object));
+      slot->next = free_;
+      free_ = slot;
+    }
+
+    /* Number of allocated objects. */
+    std::size_t size() const { return size_; }
+
+  private:
+    static std::size_t kMinChunkSize() { return 16; }
+    static std::size_t kMaxChunkSize() { return 4096; }
+
+    union Slot {
+      Slot *next;
+      alignas(T) unsigned char object[sizeof(T)];
+    };
+
+    std::vector<Slot*> chunks_;
+    // size of the last chunk and number of slots handed out from it
+    std::size_t chunk_size_;
+    std::size_t used_;
+    Slot *free_;
+    std::size_t size_;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "../utils/thread_pool.h"
+
+/*
+ * Boolean matrix with every row stored as a bitset of 64-bit words.  Sums and
+ * products of rows are bitwise ORs and ANDs of whole words, so the product
+ * and the (reflexive and transitive) closure need only O(n^3 / 64) word
+ * operations.  The unused bits at the end of every row are always zero.
+ */
+class BitMatrix {
+  public:
+    typedef std::uint64_t Word;
+
+    BitMatrix(std::size_t rows, std::size_t columns)
+        : rows_(rows), columns_(columns), words_per_row_((columns + 63) / 64),
+          words_(rows * words_per_row_, 0) {}
+
+    std::size_t getRows() const { return rows_; }
+    std::size_t getColumns() const { return columns_; }
+
+    bool Get(std::size_t r, std::size_t c) const {
+      assert(r < rows_ && c < columns_);
+      return (Row(r)[c / 64] >> (c % 64)) & 1;
+    }
+
+    void Set(std::size_t r, std::size_t c) {
+      assert(r < rows_ && c < columns_);
+      Row(r)[c / 64] |= Word(1) << (c % 64);
+    }
+
+    Word* Row(std::size_t r) { return words_.data() + r * words_per_row_; }
+    const Word* Row(std::size_t r) const { return words_.data() + r * words_per_row_; }
+
+    bool operator==(const BitMatrix &rhs) const {
+      return rows_ == rhs.rows_ && columns_ == rhs.columns_ && words_ == rhs.words_;
+    }
+
+    /* Row r of the product is the OR of the rows k of rhs for which (r, k) is
+     * set.  The rows are computed in parallel on the given pool. */
+    BitMatrix Multiply(const BitMatrix &rhs, ThreadPool *pool = nullptr) const {
+      assert(columns_ == rhs.rows_);
+      BitMatrix result{rows_, rhs.columns_};
+      const std::size_t words = rhs.words_per_row_;
+      ParallelFor(pool, rows_, kMinParallelRows(), [&](std::size_t r) {
+        Word *target = result.Row(r);
+        ForEachSetBit(r, [&](std::size_t k) {
+          const Word *source = rhs.Row(k);
+          for (std::size_t w = 0; w < words; ++w) {
+            target[w] |= source[w];
+          }
+        });
+      });
+      return result;
+    }
+
+    /*
+     * Reflexive and transitive closure (i.e., the star in the boolean
+     * semiring) with Warshall's algorithm: after setting the diagonal, for
+     * every k all rows that contain k get the bits of row k.  The rows of a
+     * round are independent and processed in parallel on the given pool.
+     */
+    void Closure(ThreadPool *pool = nullptr) {
+      assert(rows_ == columns_);
+      for (std::size_t i = 0; i < rows_; ++i) {
+        Set(i, i);
+      }
+      for (std::size_t k = 0; k < rows_; ++k) {
+        const Word *source = Row(k);
+        const std::size_t word = k / 64;
+        const Word mask = Word(1) << (k % 64);
+        ParallelFor(pool, rows_, kMinParallelRows() * 16, [&](std::size_t i) {
+          Word *target = Row(i);
+          if (i != k && (target[word] & mask)) {
+            for (std::size_t w = 0; w < words_per_row_; ++w) {
+              target[w] |= source[w];
+            }
+          }
+        });
+      }
+    }
+
+  private:
+    static std::size_t kMinParallelRows() { return 16; }
+
+    /* Calls f(c) for every column c that is set in row r. */
+    template <typename Function>
+    void ForEachSetBit(std::size_t r, Function f) const {
+      const Word *row = Row(r);
+      for (std::size_t w = 0; w < words_per_row_; ++w) {
+        Word bits = row[w];
+        while (bits) {
+          f(w * 64 + __builtin_ctzll(bits));
+          bits &= bits - 1;
+        }
+      }
+    }
+
+    std::size_t rows_;
+    std::size_t columns_;
+    std::size_t words_per_row_;
+    std::vector<Word> words_;
+};
@@ -279,6 +279,293 @@ std::string NodeToPosixString(const Node &node) {
 }
 
 
+/*
+ * CompiledDag
+ *
+ * The nodes are numbered in post-order by a depth-first search with an
+ * explicit stack.
+ */
+
+namespace {
+
+/* Reads the type and the children of a single node. */
+struct Decoder : public NodeVisitor {
+  typedef CompiledDag::Op Op;
+
+  Decoder() = default;
+  explicit Decoder(NodePtr node) { node->Accept(*this); }
+
+  void Visit(const Addition &a) { Set(Op::Addition, a.GetLhs(), a.GetRhs()); }
+  void Visit(const Multiplication &m) { Set(Op::Multiplication, m.GetLhs(), m.GetRhs()); }
+  void Visit(const Star &s) { Set(Op::Star, s.GetNode(), nullptr); }
+  void Visit(const Element &e) { Set(Op::Element, nullptr, nullptr); var = e.GetVar(); }
+  void Visit(const Epsilon &) { Set(Op::Epsilon, nullptr, nullptr); }
+  void Visit(const Empty &) { Set(Op::Empty, nullptr, nullptr); }
+
+  void Set(Op o, NodePtr l, NodePtr r) {
+    op = o;
+    children[0] = l;
+    children[1] = r;
+  }
+
+  Op op;
+  NodePtr children[2];
+  VarId var{};  // only set for an Element
+};
+
+}  // namespace
+
+CompiledDag::CompiledDag(const std::vector<NodePtr> &roots) {
+  struct Frame {
+    Decoder node;
+    NodePtr ptr;
+    std::size_t next_child;
+  };
+
+  std::unordered_map<NodePtr, std::size_t> index;
+  std::vector<Frame> stack;
+  auto push = [&stack](NodePtr node) {
+    stack.emplace_back();
+    stack.back().ptr = node;
+    stack.back().next_child = 0;
+    node->Accept(stack.back().node);
+  };
+
+  for (auto root : roots) {
+    if (index.count(root) == 0) {
+      push(root);
+    }
+    while (!stack.empty()) {
+      Frame &frame = stack.back();
+      if (frame.next_child < 2 && frame.node.children[frame.next_child] != nullptr) {
+        NodePtr child = frame.node.children[frame.next_child++];
+        if (index.count(child) == 0) {
+          push(child);  // invalidates frame
+        }
+        continue;
+      }
+      Operation operation;
+      operation.op = frame.node.op;
+      operation.lhs = frame.node.children[0] ? index[frame.node.children[0]] : 0;
+      operation.rhs = frame.node.children[1] ? index[frame.node.children[1]] : 0;
+      operation.var = frame.node.var;
+      if (operation.op == Op::Element) {
+        elements_.push_back(operations_.size());
+      }
+      index.emplace(frame.ptr, operations_.size());
+      operations_.push_back(operation);
+      stack.pop_back();
+    }
+    roots_.push_back(index[root]);
+  }
+  SortByLevel();
+}
+
+void CompiledDag::SortByLevel() {
+  const std::size_t n = operations_.size();
+  std::vector<std::size_t> level(n, 0);
+  std::size_t num_levels = n > 0 ? 1 : 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    const Operation &operation = operations_[i];
+    switch (operation.op) {
+      case Op::Addition:
+      case Op::Multiplication:
+        level[i] = std::max(level[operation.lhs], level[operation.rhs]) + 1;
+        break;
+      case Op::Star:
+        level[i] = level[operation.lhs] + 1;
+        break;
+      default:
+        break;
+    }
+    num_levels = std::max(num_levels, level[i] + 1);
+  }
+
+  // counting sort, the order within a level stays a post-order
+  level_begin_.assign(num_levels + 1, 0);
+  for (std::size_t i = 0; i < n; ++i) {
+    ++level_begin_[level[i] + 1];
+  }
+  for (std::size_t l = 0; l < num_levels; ++l) {
+    level_begin_[l + 1] += level_begin_[l];
+  }
+  std::vector<std::size_t> position(level_begin_.begin(), level_begin_.end() - 1);
+  std::vector<std::size_t> new_index(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    new_index[i] = position[level[i]]++;
+  }
+
+  std::vector<Operation> sorted(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    Operation operation = operations_[i];
+    operation.lhs = new_index[operation.lhs];
+    operation.rhs = new_index[operation.rhs];
+    sorted[new_index[i]] = operation;
+  }
+  operations_ = std::move(sorted);
+  for (auto &root : roots_) {
+    root = new_index[root];
+  }
+  for (auto &element : elements_) {
+    element = new_index[element];
+  }
+}
+
+
+/*
+ * RegisterProgram
+ */
+
+namespace {
+
+std::size_t NumOperands(CompiledDag::Op op) {
+  switch (op) {
+    case CompiledDag::Op::Addition:
+    case CompiledDag::Op::Multiplication:
+      return 2;
+    case CompiledDag::Op::Star:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+std::size_t GetOperand(const CompiledDag::Operation &operation, std::size_t k) {
+  return k == 0 ? operation.lhs : operation.rhs;
+}
+
+}  // namespace
+
+RegisterProgram::RegisterProgram(const CompiledDag &dag) {
+  typedef CompiledDag::Op Op;
+  const std::size_t n = dag.size();
+  assert(n <= UINT32_MAX);
+
+  // the height of every operation (the DAG is in topological order)
+  std::vector<std::size_t> height(n, 0);
+  for (std::size_t i = 0; i < n; ++i) {
+    for (std::size_t k = 0; k < NumOperands(dag[i].op); ++k) {
+      height[i] = std::max(height[i], height[GetOperand(dag[i], k)] + 1);
+    }
+  }
+  // the k-th operand to visit, the higher one first, since otherwise the
+  // value of the lower one would be kept in a register during the whole
+  // evaluation of the higher one (e.g., for a long sum nested on the right)
+  auto visit_operand = [&dag, &height](std::size_t i, std::size_t k) {
+    const CompiledDag::Operation &operation = dag[i];
+    const bool rhs_first = NumOperands(operation.op) == 2 &&
+                           height[operation.rhs] > height[operation.lhs];
+    return GetOperand(operation, rhs_first ? 1 - k : k);
+  };
+
+  // depth-first order of the operations, the pairs on the stack are the
+  // operation and the number of its operands visited so far
+  std::vector<std::size_t> order;
+  order.reserve(n);
+  std::vector<bool> visited(n, false);
+  std::vector< std::pair<std::size_t, std::size_t> > stack;
+  for (auto root : dag.GetRoots()) {
+    if (visited[root]) {
+      continue;
+    }
+    visited[root] = true;
+    stack.emplace_back(root, 0);
+    while (!stack.empty()) {
+      const std::size_t i = stack.back().first;
+      const std::size_t k = stack.back().second;
+      if (k < NumOperands(dag[i].op)) {
+        ++stack.back().second;
+        const std::size_t operand = visit_operand(i, k);
+        if (!visited[operand]) {
+          visited[operand] = true;
+          stack.emplace_back(operand, 0);
+        }
+        continue;
+      }
+      order.push_back(i);
+      stack.pop_back();
+    }
+  }
+
+  // the position in the order of the last instruction using every value
+  std::vector<std::size_t> last_use(n, 0);
+  for (std::size_t pos = 0; pos < order.size(); ++pos) {
+    const CompiledDag::Operation &operation = dag[order[pos]];
+    for (std::size_t k = 0; k < NumOperands(operation.op); ++k) {
+      last_use[GetOperand(operation, k)] = pos;
+    }
+  }
+  std::vector<bool> is_root(n, false);
+  for (auto root : dag.GetRoots()) {
+    is_root[root] = true;
+  }
+
+  std::vector<std::uint32_t> reg(n, 0);
+  std::vector<std::uint32_t> free_registers;
+  std::unordered_map<VarId, std::uint32_t> input_index;
+  instructions_.reserve(order.size());
+  for (std::size_t pos = 0; pos < order.size(); ++pos) {
+    const std::size_t i = order[pos];
+    const CompiledDag::Operation &operation = dag[i];
+
+    Instruction instruction;
+    instruction.lhs = 0;
+    instruction.rhs = 0;
+    switch (operation.op) {
+      case Op::Addition:
+        instruction.op = Opcode::Add;
+        break;
+      case Op::Multiplication:
+        instruction.op = Opcode::Mul;
+        break;
+      case Op::Star:
+        instruction.op = Opcode::Star;
+        break;
+      case Op::Element: {
+        instruction.op = Opcode::Load;
+        auto result = input_index.emplace(operation.var, inputs_.size());
+        if (result.second) {
+          inputs_.push_back(operation.var);
+        }
+        instruction.lhs = result.first->second;
+        break;
+      }
+      case Op::Epsilon:
+        instruction.op = Opcode::One;
+        break;
+      case Op::Empty:
+        instruction.op = Opcode::Zero;
+        break;
+    }
+
+    // registers of operands that are not needed afterwards can already take
+    // the result (every instruction reads its operands before writing)
+    const std::size_t num_operands = NumOperands(operation.op);
+    for (std::size_t k = 0; k < num_operands; ++k) {
+      const std::size_t operand = GetOperand(operation, k);
+      (k == 0 ? instruction.lhs : instruction.rhs) = reg[operand];
+      const bool repeated = k == 1 && operand == operation.lhs;
+      if (last_use[operand] == pos && !is_root[operand] && !repeated) {
+        free_registers.push_back(reg[operand]);
+      }
+    }
+
+    if (free_registers.empty()) {
+      reg[i] = num_registers_++;
+    } else {
+      reg[i] = free_registers.back();
+      free_registers.pop_back();
+    }
+    instruction.dst = reg[i];
+    instructions_.push_back(instruction);
+  }
+
+  for (auto root : dag.GetRoots()) {
+    outputs_.push_back(reg[root]);
+  }
+}
+
+
 /*
  * NodeFactory
  *
@@ -286,15 +573,40 @@ std::string NodeToPosixString(const Node &node) {
  * not worth the effort to abstract away the common parts...
  */
 
-NodePtr NodeFactory::NewAddition(NodePtr lhs, NodePtr rhs) {
+namespace {
+
+/* The node below a Star, nullptr for any other node. */
+NodePtr StarOperand(NodePtr node) {
+  Decoder decoder{node};
+  return decoder.op == CompiledDag::Op::Star ? decoder.children[0] : nullptr;
+}
+
+}  // namespace
+
+NodePtr NodeFactory::NewAddition(NodePtr lhs, NodePtr rhs, SemiringLaws laws) {
   assert(lhs);
   assert(rhs);
 
   if (lhs == empty_) {
-    return rhs;
+    return Acquire(rhs);
   }
   if (rhs == empty_) {
-    return lhs;
+    return Acquire(lhs);
+  }
+
+  if (laws.idempotent) {
+    if (lhs == rhs) {
+      return Acquire(lhs);
+    }
+    // x* = 1 + x x* is greater than both 1 and x
+    NodePtr lhs_operand = StarOperand(lhs);
+    if (lhs_operand != nullptr && (rhs == lhs_operand || rhs == epsilon_)) {
+      return Acquire(lhs);
+    }
+    NodePtr rhs_operand = StarOperand(rhs);
+    if (rhs_operand != nullptr && (lhs == rhs_operand || lhs == epsilon_)) {
+      return Acquire(rhs);
+    }
   }
 
   /* Since + is commutative, use pointers to order the arguments.
@@ -304,77 +616,235 @@ NodePtr NodeFactory::NewAddition(NodePtr lhs, NodePtr rhs) {
     std::swap(lhs, rhs);
   }
 
-  auto iter = additions_.find({lhs, rhs});
-  if (iter != additions_.end()) {
-    return iter->second;
+  MaybeCollect();
+  const std::pair<NodePtr, NodePtr> key{lhs, rhs};
+  Shard &shard = GetShard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto iter = shard.additions.find(key);
+  if (iter != shard.additions.end()) {
+    return Acquire(iter->second);
   }
-  NodePtr node_ptr{new Addition(lhs, rhs)};
-  additions_.insert({ {lhs, rhs}, node_ptr });
-  return node_ptr;
+  NodePtr node_ptr{new (shard.addition_arena.Allocate()) Addition(lhs, rhs)};
+  shard.additions.insert({key, node_ptr});
+  ++size_;
+  return Acquire(node_ptr);
 }
 
-NodePtr NodeFactory::NewMultiplication(NodePtr lhs, NodePtr rhs) {
+NodePtr NodeFactory::NewMultiplication(NodePtr lhs, NodePtr rhs, SemiringLaws laws) {
   assert(lhs);
   assert(rhs);
 
   if (lhs == epsilon_) {
-    return rhs;
+    return Acquire(rhs);
   }
   if (rhs == epsilon_) {
-    return lhs;
+    return Acquire(lhs);
   }
 
   if (lhs == empty_ || rhs == empty_) {
-    return empty_;
+    return Acquire(empty_);
+  }
+
+  if (laws.idempotent && lhs == rhs && StarOperand(lhs) != nullptr) {
+    return Acquire(lhs);
+  }
+  if (laws.commutative && lhs > rhs) {
+    std::swap(lhs, rhs);
   }
 
-  auto iter = multiplications_.find({lhs, rhs});
-  if (iter != multiplications_.end()) {
-    return iter->second;
+  MaybeCollect();
+  const std::pair<NodePtr, NodePtr> key{lhs, rhs};
+  Shard &shard = GetShard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto iter = shard.multiplications.find(key);
+  if (iter != shard.multiplications.end()) {
+    return Acquire(iter->second);
   }
-  NodePtr node_ptr{new Multiplication(lhs, rhs)};
-  multiplications_.insert({ {lhs, rhs}, node_ptr });
-  return node_ptr;
+  NodePtr node_ptr{new (shard.multiplication_arena.Allocate()) Multiplication(lhs, rhs)};
+  shard.multiplications.insert({key, node_ptr});
+  ++size_;
+  return Acquire(node_ptr);
 }
 
-NodePtr NodeFactory::NewStar(NodePtr node) {
+NodePtr NodeFactory::NewStar(NodePtr node, SemiringLaws laws) {
   assert(node);
 
   if (node == empty_) {
-    return epsilon_;
+    return Acquire(epsilon_);
+  }
+
+  if (laws.idempotent) {
+    if (node == epsilon_ || StarOperand(node) != nullptr) {
+      return Acquire(node);
+    }
+    // (1 + x)* = x*, x is safe from the GC since node is referenced
+    Decoder sum{node};
+    if (sum.op == CompiledDag::Op::Addition &&
+        (sum.children[0] == epsilon_ || sum.children[1] == epsilon_)) {
+      return NewStar(sum.children[0] == epsilon_ ? sum.children[1] : sum.children[0], laws);
+    }
   }
 
-  auto iter = stars_.find(node);
-  if (iter != stars_.end()) {
-    return iter->second;
+  MaybeCollect();
+  Shard &shard = GetShard(node);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto iter = shard.stars.find(node);
+  if (iter != shard.stars.end()) {
+    return Acquire(iter->second);
   }
-  NodePtr node_ptr{new Star(node)};
-  stars_.insert({node, node_ptr});
-  return node_ptr;
+  NodePtr node_ptr{new (shard.star_arena.Allocate()) Star(node)};
+  shard.stars.insert({node, node_ptr});
+  ++size_;
+  return Acquire(node_ptr);
 }
 
 NodePtr NodeFactory::NewElement(VarId var) {
-  auto iter = elems_.find(var);
-  if (iter != elems_.end()) {
-    return iter->second;
+  MaybeCollect();
+  Shard &shard = GetShard(var);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto iter = shard.elems.find(var);
+  if (iter != shard.elems.end()) {
+    return Acquire(iter->second);
+  }
+  NodePtr node_ptr{new (shard.element_arena.Allocate()) Element(var)};
+  shard.elems.insert({var, node_ptr});
+  ++size_;
+  return Acquire(node_ptr);
+}
+
+/* The hashes of pointers are mostly multiples of the alignment, so the shard
+ * is taken from the high bits of the (Fibonacci) scrambled hash. */
+template <typename Key>
+NodeFactory::Shard& NodeFactory::GetShard(const Key &key) {
+  const std::uint64_t hash = std::hash<Key>()(key);
+  return shards_[((hash * UINT64_C(0x9e3779b97f4a7c15)) >> 32) % kNumShards()];
+}
+
+std::vector< std::unique_lock<std::mutex> > NodeFactory::LockShards() {
+  std::vector< std::unique_lock<std::mutex> > locks;
+  locks.reserve(kNumShards());
+  for (std::size_t i = 0; i < kNumShards(); ++i) {
+    locks.emplace_back(shards_[i].mutex);
   }
-  NodePtr node_ptr{new Element(var)};
-  elems_.insert({var, node_ptr});
-  return node_ptr;
+  return locks;
 }
 
 void NodeFactory::GC() {
-  assert(false);
+  auto locks = LockShards();
+  Collect();
+}
+
+std::size_t NodeFactory::GetNumNodes() {
+  return size_;
+}
+
+void NodeFactory::SetGCThreshold(std::size_t gc_threshold) {
+  auto locks = LockShards();
+  gc_threshold_ = gc_threshold;
+  next_gc_ = gc_threshold;
+}
+
+/* Collecting only when the number of nodes doubled since the last collection
+ * keeps the amortized cost per node constant, even if most nodes are
+ * alive. */
+void NodeFactory::MaybeCollect() {
+  if (gc_threshold_ == 0 || size_ < next_gc_) {
+    return;
+  }
+  auto locks = LockShards();
+  // another thread may have collected in the meantime
+  if (gc_threshold_ == 0 || size_ < next_gc_) {
+    return;
+  }
+  Collect();
+  next_gc_ = std::max<std::size_t>(gc_threshold_, 2 * size_);
+}
+
+void NodeFactory::Collect() {
+  /* Pushes the children of a node. */
+  struct ChildrenVisitor : public NodeVisitor {
+    ChildrenVisitor(std::vector<NodePtr> &s) : stack(s) {}
+    void Visit(const Addition &a) { stack.push_back(a.GetLhs()); stack.push_back(a.GetRhs()); }
+    void Visit(const Multiplication &m) { stack.push_back(m.GetLhs()); stack.push_back(m.GetRhs()); }
+    void Visit(const Star &s) { stack.push_back(s.GetNode()); }
+    void Visit(const Element &) {}
+    void Visit(const Epsilon &) {}
+    void Visit(const Empty &) {}
+    std::vector<NodePtr> &stack;
+  };
+
+  std::vector<NodePtr> stack;
+  auto add_root = [&stack](NodePtr node) {
+    if (node->references_ > 0) {
+      stack.push_back(node);
+    }
+  };
+  for (std::size_t i = 0; i < kNumShards(); ++i) {
+    for (auto &pair : shards_[i].additions) { add_root(pair.second); }
+    for (auto &pair : shards_[i].multiplications) { add_root(pair.second); }
+    for (auto &pair : shards_[i].stars) { add_root(pair.second); }
+    for (auto &pair : shards_[i].elems) { add_root(pair.second); }
+  }
+
+  ChildrenVisitor children{stack};
+  while (!stack.empty()) {
+    NodePtr node = stack.back();
+    stack.pop_back();
+    if (node == empty_ || node == epsilon_ || node->marked_) {
+      continue;
+    }
+    node->marked_ = true;
+    node->Accept(children);
+  }
+
+  std::size_t size = 0;
+  for (std::size_t i = 0; i < kNumShards(); ++i) {
+    Shard &shard = shards_[i];
+    Sweep(shard.additions, shard.addition_arena);
+    Sweep(shard.multiplications, shard.multiplication_arena);
+    Sweep(shard.stars, shard.star_arena);
+    Sweep(shard.elems, shard.element_arena);
+    size += shard.additions.size() + shard.multiplications.size() +
+            shard.stars.size() + shard.elems.size();
+  }
+  size_ = size;
+}
+
+template <typename Map, typename T>
+void NodeFactory::Sweep(Map &map, Arena<T> &arena) {
+  std::size_t live = 0;
+  for (auto &pair : map) {
+    live += pair.second->marked_;
+  }
+  Map compact;
+  compact.reserve(live);
+  for (auto &pair : map) {
+    if (pair.second->marked_) {
+      pair.second->marked_ = false;
+      compact.insert(pair);
+    } else {
+      arena.Free(static_cast<const T*>(pair.second));
+    }
+  }
+  map.swap(compact);
 }
 
 void NodeFactory::PrintStats(std::ostream &out) {
+  auto locks = LockShards();
+  std::size_t additions = 0, multiplications = 0, stars = 0, elems = 0;
+  for (std::size_t i = 0; i < kNumShards(); ++i) {
+    additions += shards_[i].additions.size();
+    multiplications += shards_[i].multiplications.size();
+    stars += shards_[i].stars.size();
+    elems += shards_[i].elems.size();
+  }
   std::cout << "Size (free-struct): "
-    << additions_.size() + multiplications_.size()+ stars_.size()
+    << additions + multiplications + stars
     << std::endl;
-  std::cout << "Add (free-struct): " << additions_.size() << std::endl;
-  std::cout << "Mult (free-struct): " << multiplications_.size() << std::endl;
-  std::cout << "Stars (free-struct): " << stars_.size() << std::endl;
-  std::cout << "Elems (free-struct): " << elems_.size() << std::endl;
+  std::cout << "Add (free-struct): " << additions << std::endl;
+  std::cout << "Mult (free-struct): " << multiplications << std::endl;
+  std::cout << "Stars (free-struct): " << stars << std::endl;
+  std::cout << "Elems (free-struct): " << elems << std::endl;
 }
 
 
@@ -409,27 +879,32 @@ void NodeFactory::PrintDot(std::ostream &out) {
     out << "\"]" << std::endl;
   };
 
-  for (auto &children_parent : additions_) {
-    print_node(children_parent.second);
-    print_edge(children_parent.second, children_parent.first.first);
-    print_edge(children_parent.second, children_parent.first.second);
-  }
+  auto locks = LockShards();
+  for (std::size_t i = 0; i < kNumShards(); ++i) {
+    const Shard &shard = shards_[i];
 
-  for (auto &children_parent : multiplications_) {
-    print_node(children_parent.second);
-    print_edge(children_parent.second, children_parent.first.first);
-    print_edge(children_parent.second, children_parent.first.second);
-  }
+    for (auto &children_parent : shard.additions) {
+      print_node(children_parent.second);
+      print_edge(children_parent.second, children_parent.first.first);
+      print_edge(children_parent.second, children_parent.first.second);
+    }
 
-  for (auto &child_parent : stars_) {
-    print_node(child_parent.second);
-    print_edge(child_parent.second, child_parent.first);
-  }
+    for (auto &children_parent : shard.multiplications) {
+      print_node(children_parent.second);
+      print_edge(children_parent.second, children_parent.first.first);
+      print_edge(children_parent.second, children_parent.first.second);
+    }
 
-  for (auto &child_parent : elems_) {
-    out << "\"" << child_parent.second << "\""
-        << " [label=\"" << child_parent.first << "\"]"
-        << std::endl;
+    for (auto &child_parent : shard.stars) {
+      print_node(child_parent.second);
+      print_edge(child_parent.second, child_parent.first);
+    }
+
+    for (auto &child_parent : shard.elems) {
+      out << "\"" << child_parent.second << "\""
+          << " [label=\"" << child_parent.first << "\"]"
+          << std::endl;
+    }
   }
 
   print_node(empty_);
@@ -1,8 +1,15 @@
 #pragma once
 
+#include <atomic>
+#include <cassert>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
+#include "arena.h"
 #include "var.h"
 #include "hash.h"
 
@@ -27,6 +34,13 @@ class Node {
   public:
     virtual ~Node() {}
     virtual void Accept(NodeVisitor &visitor) const = 0;
+
+  private:
+    /* References from outside of the NodeFactory and the mark of the garbage
+     * collection, see [Note: Garbage]. */
+    mutable std::atomic<std::uint32_t> references_{0};
+    mutable bool marked_ = false;
+    friend class NodeFactory;
 };
 
 class StringPrinter;
@@ -133,50 +147,259 @@ class Epsilon : public Node {
     friend class NodeFactory;
 };
 
+/*
+ * SemiringLaws
+ *
+ * Laws that hold in all the semirings some nodes are going to be evaluated in,
+ * beyond the ones of every semiring.  NodeFactory can use them to build
+ * smaller DAGs (see NodeFactory::NewAddition etc.).
+ */
+struct SemiringLaws {
+  constexpr SemiringLaws(bool c = false, bool i = false)
+      : commutative(c), idempotent(i) {}
+
+  bool commutative;
+  bool idempotent;
+};
+
+/*
+ * NodeFactory
+ *
+ * The New* functions apply the laws of all (starable) semirings where they
+ * shrink the DAG right away, i.e., 0 + x = x + 0 = x, 1 * x = x * 1 = x,
+ * 0 * x = x * 0 = 0 and 0* = 1.  If the given laws include
+ *   commutativity, the operands of * are ordered like the ones of +, so that
+ *     x * y and y * x are the same node,
+ *   idempotence, x + x = x, x + x* = x* + x = x*, 1 + x* = x* + 1 = x*,
+ *     x* * x* = x*, (x*)* = x*, 1* = 1 and (1 + x)* = (x + 1)* = x*.
+ * None of these rewrites stores anything in the hash maps, so the nodes built
+ * with and without the laws can be mixed freely.
+ */
 class NodeFactory {
   public:
-    NodeFactory() : empty_(new Empty), epsilon_(new Epsilon) {}
+    /* If gc_threshold is not 0, GC() is called automatically whenever the
+     * number of nodes reaches the threshold (or twice the number of nodes
+     * left by the last collection, if that is larger). */
+    explicit NodeFactory(std::size_t gc_threshold = 0)
+        : shards_(new Shard[kNumShards()]), size_(0),
+          empty_(new Empty), epsilon_(new Epsilon),
+          gc_threshold_(gc_threshold), next_gc_(gc_threshold) {}
+    /* The nodes in the arenas are released all at once. */
     virtual ~NodeFactory() {
-      for (auto &pair : additions_) { delete pair.second; }
-      for (auto &pair : multiplications_) { delete pair.second; }
-      for (auto &pair : stars_) { delete pair.second; }
-      for (auto &pair : elems_) { delete pair.second; }
       delete empty_;
       delete epsilon_;
     }
 
-    virtual NodePtr NewAddition(NodePtr lhs, NodePtr rhs);
-    virtual NodePtr NewMultiplication(NodePtr lhs, NodePtr rhs);
-    virtual NodePtr NewStar(NodePtr node);
+    /* The New* functions return the node with one reference acquired for the
+     * caller, and their arguments have to be referenced (see [Note: Garbage]).
+     * GetEmpty() and GetEpsilon() do not acquire anything, these two nodes are
+     * never collected. */
+    virtual NodePtr NewAddition(NodePtr lhs, NodePtr rhs,
+                                SemiringLaws laws = SemiringLaws());
+    virtual NodePtr NewMultiplication(NodePtr lhs, NodePtr rhs,
+                                      SemiringLaws laws = SemiringLaws());
+    virtual NodePtr NewStar(NodePtr node, SemiringLaws laws = SemiringLaws());
     virtual NodePtr NewElement(VarId var);
     virtual NodePtr GetEmpty() const { return empty_; }
     virtual NodePtr GetEpsilon() const { return epsilon_; }
 
+    static NodePtr Acquire(NodePtr node) {
+      ++node->references_;
+      return node;
+    }
+
+    static void Release(NodePtr node) {
+      assert(node->references_ > 0);
+      --node->references_;
+    }
+
     virtual void PrintDot(std::ostream &out);
     virtual void GC();
     virtual void PrintStats(std::ostream &out = std::cout);
 
+    /* Number of nodes (not counting the empty and epsilon nodes). */
+    std::size_t GetNumNodes();
+
+    void SetGCThreshold(std::size_t gc_threshold);
+
   private:
-    std::unordered_map< std::pair<NodePtr, NodePtr>, NodePtr > additions_;
-    std::unordered_map< std::pair<NodePtr, NodePtr>, NodePtr > multiplications_;
-    std::unordered_map< NodePtr, NodePtr > stars_;
-    std::unordered_map< VarId, NodePtr > elems_;
+    /*
+     * The nodes are spread over the shards by the hash of their operands (or
+     * variable), and every shard has its own maps, arenas and mutex.  So
+     * threads creating nodes at the same time only wait for each other if
+     * they need the same shard, and since equal nodes always end up in the
+     * same shard, every node still exists only once.  Existing nodes are
+     * immutable, so reading them does not need any locking.
+     */
+    struct Shard {
+      std::unordered_map< std::pair<NodePtr, NodePtr>, NodePtr > additions;
+      std::unordered_map< std::pair<NodePtr, NodePtr>, NodePtr > multiplications;
+      std::unordered_map< NodePtr, NodePtr > stars;
+      std::unordered_map< VarId, NodePtr > elems;
+
+      /* All the nodes in the maps are allocated here (in creation order).
+       * The arenas start with small chunks, so the shards of a small system
+       * do not take much memory. */
+      Arena<Addition> addition_arena;
+      Arena<Multiplication> multiplication_arena;
+      Arena<Star> star_arena;
+      Arena<Element> element_arena;
+
+      std::mutex mutex;
+    };
+
+    static std::size_t kNumShards() { return 16; }
+
+    template <typename Key>
+    Shard& GetShard(const Key &key);
+
+    /* Locks all the shards, always in the same order so that concurrent
+     * calls cannot deadlock. */
+    std::vector< std::unique_lock<std::mutex> > LockShards();
+
+    /* Calls Collect() if the threshold is reached, the calling thread must
+     * not hold the lock of any shard. */
+    void MaybeCollect();
+
+    /* Mark and sweep, all the shards have to be locked. */
+    void Collect();
+
+    /* Frees the unmarked nodes of the map and rebuilds it with the other
+     * ones, whose marks are cleared. */
+    template <typename Map, typename T>
+    static void Sweep(Map &map, Arena<T> &arena);
+
+    std::unique_ptr<Shard[]> shards_;
+    // number of nodes in all the shards
+    std::atomic<std::size_t> size_;
     NodePtr empty_;
     NodePtr epsilon_;
+
+    std::atomic<std::size_t> gc_threshold_;
+    std::atomic<std::size_t> next_gc_;
+};
+
+/*
+ * CompiledDag
+ *
+ * The DAG below a set of nodes as a flat array of operations in topological
+ * order (every operation comes after its operands), where the operands are
+ * referred to by their indices.  So it can be evaluated by a single loop over
+ * the array without recursion (which overflows the stack for deep
+ * expressions, e.g., the entries of a large Jacobian star) and without
+ * looking up the nodes in a hash map.  The DAG is built once and can then be
+ * evaluated in any number of semirings and valuations (see DagEvaluator in
+ * free-semiring.h).
+ *
+ * The operations are grouped by their level (the length of the longest path
+ * down to a leaf), so the operations of a level only depend on the ones of the
+ * previous levels and can be evaluated in parallel.
+ */
+class CompiledDag {
+  public:
+    enum class Op { Addition, Multiplication, Star, Element, Epsilon, Empty };
+
+    struct Operation {
+      Op op;
+      // operands of Addition and Multiplication (only lhs for Star)
+      std::size_t lhs;
+      std::size_t rhs;
+      // only for Element
+      VarId var;
+    };
+
+    CompiledDag() = default;
+    explicit CompiledDag(const std::vector<NodePtr> &roots);
+
+    std::size_t size() const { return operations_.size(); }
+
+    const Operation& operator[](std::size_t i) const { return operations_[i]; }
+
+    /* Indices of the roots in the order given to the constructor. */
+    const std::vector<std::size_t>& GetRoots() const { return roots_; }
+
+    /* Indices of the Element operations. */
+    const std::vector<std::size_t>& GetElements() const { return elements_; }
+
+    /* The operations of level l are the ones with indices in
+     * [LevelBegin(l), LevelEnd(l)), level 0 contains the leaves. */
+    std::size_t GetNumLevels() const { return level_begin_.size() - 1; }
+    std::size_t LevelBegin(std::size_t l) const { return level_begin_[l]; }
+    std::size_t LevelEnd(std::size_t l) const { return level_begin_[l + 1]; }
+
+  private:
+    /* Sorts the operations (stably) by their level. */
+    void SortByLevel();
+
+    std::vector<Operation> operations_;
+    std::vector<std::size_t> roots_;
+    std::vector<std::size_t> elements_;
+    std::vector<std::size_t> level_begin_ = {0};
+};
+
+/*
+ * RegisterProgram
+ *
+ * A CompiledDag lowered to instructions on a small number of registers, which
+ * are reused as soon as the value they hold is not needed any more (except
+ * for the ones holding the roots).  The instructions follow a depth-first
+ * order, so that most values are used shortly after being computed, and the
+ * values of all the variables are looked up once before running the program
+ * (Load reads them from a dense array of inputs).  Shared subexpressions are
+ * still computed only once.  This keeps the working set of the evaluation
+ * small, which matters for the semirings where the arithmetic itself is cheap
+ * (see RegisterMachine in free-semiring.h).
+ */
+class RegisterProgram {
+  public:
+    enum class Opcode : std::uint8_t { Load, Add, Mul, Star, One, Zero };
+
+    struct Instruction {
+      Opcode op;
+      std::uint32_t dst;
+      // the input for Load, the operand(s) for Add, Mul and Star
+      std::uint32_t lhs;
+      std::uint32_t rhs;
+    };
+
+    RegisterProgram() = default;
+    explicit RegisterProgram(const CompiledDag &dag);
+
+    const std::vector<Instruction>& GetInstructions() const { return instructions_; }
+
+    /* The distinct variables, Load refers to them by their index. */
+    const std::vector<VarId>& GetInputs() const { return inputs_; }
+
+    /* The registers holding the values of the roots of the DAG. */
+    const std::vector<std::uint32_t>& GetOutputs() const { return outputs_; }
+
+    std::size_t GetNumRegisters() const { return num_registers_; }
+
+  private:
+    std::vector<Instruction> instructions_;
+    std::vector<VarId> inputs_;
+    std::vector<std::uint32_t> outputs_;
+    std::size_t num_registers_ = 0;
 };
 
 /*
  * [Note: Garbage]
  *
- * The current version of NodeFactory will never deallocate Nodes since we
- * always keep at least one reference in the std::unordered_maps.  We should
- * probably introduce external reference count (external as in not counting the
- * references kept by NodeFactory itself).
+ * NodeFactory always keeps a reference to every node in its
+ * std::unordered_maps, so every node additionally has an external reference
+ * count (external as in not counting the references kept by NodeFactory
+ * itself), which is maintained by the handles (see FreeSemiring).
  *
- * But we have to be careful with this because we can easily end up destroying
- * and creating the same object repeatedly during the fixed-point computation.
- * One way out of this would be to perform something like a garbage collection.
- * So instead of deallocating (and removing the entry from unordered_map) as
- * soon as the external reference count is 0, do that from time to time.
+ * We do not deallocate a node as soon as its count drops to 0, since then we
+ * could easily end up destroying and creating the same node repeatedly during
+ * the fixed-point computation.  Instead GC() performs a mark and sweep from
+ * time to time: all the nodes with external references are roots, everything
+ * reachable from them is kept and the rest is deleted, and the maps are built
+ * again with only the live nodes.  This is only safe if nobody holds a NodePtr
+ * that is neither referenced nor reachable from a referenced node, which is
+ * why the New* functions already acquire a reference for their result (and
+ * thus another thread collecting in between cannot delete it).
  *
+ * LossySemiring does not release its references, so its nodes are never
+ * collected.
  */
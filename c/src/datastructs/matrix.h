@@ -5,14 +5,24 @@
 #include <initializer_list>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <iostream>
 
+#include "../semirings/semiring.h"
+#include "../utils/thread_pool.h"
+
+#include "matrix_kernels.h"
+
 //TODO: += operator
 
 template <typename SR>
 class Matrix {
+  /* Semirings with scalar elements use the kernels of matrix_kernels.h for
+   * the expensive operations, all others the generic versions below. */
+  typedef std::integral_constant<bool, ScalarSemiring<SR>::value> IsScalar;
+
   public:
     Matrix(const Matrix &m) = default;
     Matrix(Matrix &&m)
@@ -76,6 +86,16 @@ class Matrix {
     Matrix operator+(const Matrix &mat) const {
       assert(rows_ == mat.rows_ && columns_ == mat.columns_ &&
              elements_.size() == mat.elements_.size());
+      return Add(mat, IsScalar());
+    };
+
+    Matrix operator*(const Matrix &rhs) const {
+      assert(columns_ == rhs.rows_);
+      return Multiply(rhs, IsScalar());
+    };
+
+  private:
+    Matrix Add(const Matrix &mat, std::false_type) const {
       std::vector<SR> result;
       result.reserve(elements_.size());
       for (std::size_t i = 0; i < columns_ * rows_; ++i) {
@@ -83,10 +103,26 @@ class Matrix {
       }
 
       return Matrix{rows_, std::move(result)};
-    };
+    }
 
-    Matrix operator*(const Matrix &rhs) const {
-      assert(columns_ == rhs.rows_);
+    Matrix Add(const Matrix &mat, std::true_type) const {
+      typedef ScalarSemiring<SR> Traits;
+      std::vector<SR> result;
+      result.reserve(elements_.size());
+      for (std::size_t i = 0; i < columns_ * rows_; ++i) {
+        result.emplace_back(Traits::Make(
+              Traits::Add(Traits::Get(elements_[i]), Traits::Get(mat.elements_[i]))));
+      }
+
+      return Matrix{rows_, std::move(result)};
+    }
+
+    Matrix Multiply(const Matrix &rhs, std::true_type) const {
+      return Matrix{rows_, ScalarMatrixKernels<SR>::Multiply(
+            elements_, rhs.elements_, rows_, columns_, rhs.columns_)};
+    }
+
+    Matrix Multiply(const Matrix &rhs, std::false_type) const {
       Matrix result{rows_, rhs.columns_, SR::null()};
       for (std::size_t r = 0; r < rows_; ++r) {
         for (std::size_t c = 0; c < rhs.columns_; ++c) {
@@ -100,9 +136,23 @@ class Matrix {
         }
       }
       return result;
-    };
+    }
+
+    // for scalar semirings both star() and star2() use the kernels on the
+    // packed elements
+    Matrix ScalarClosure() const {
+      return Matrix{rows_, ScalarMatrixKernels<SR>::Star(elements_, rows_)};
+    }
+
+    Matrix Star(std::true_type) const { return ScalarClosure(); }
+    Matrix Star(std::false_type) const { return recursive_star2(*this); }
+
+    Matrix Star2(std::true_type) const { return ScalarClosure(); }
+    Matrix Star2(std::false_type) const { return FloydWarshall(); }
 
-    bool operator==(const Matrix &rhs) {
+  public:
+
+    bool operator==(const Matrix &rhs) const {
       assert(rows_ == rhs.rows_ && columns_ == rhs.columns_ &&
              elements_.size() == rhs.elements_.size());
       return elements_ == rhs.elements_;
@@ -110,29 +160,49 @@ class Matrix {
 
     /*
      * Floyd-Warshall implementation from the Handbook of Weighted Automata (optimized -- common subexpression optimization)
+     *
+     * The matrix is processed in square tiles (blocked Floyd-Warshall): for
+     * every diagonal tile K we compute its closure A_KK^* with the scalar
+     * algorithm and then, as in the scalar version,
+     *   A_IK = A_IK A_KK^*,  A_IJ += A_IK A_KJ,  A_KJ = A_KK^* A_KJ
+     * for all tiles I, J != K.  All tiles of each of these three steps are
+     * independent, so they are processed in parallel on the solver thread pool.
      */
     Matrix FloydWarshall() const {
       assert(columns_ == rows_);
       Matrix result = *this;
-      for (std::size_t k = 0; k < rows_; ++k) {
-        result.At(k,k) = result.At(k, k).star();
-        for (std::size_t i = 0; i < rows_; ++i) {
-          if(i==k)
-            continue;
-          result.At(i, k) = result.At(i, k) * result.At(k,k);
-          for (std::size_t j = 0; j < rows_; ++j) {
-            if(j==k)
-              continue;
-            result.At(i, j) +=
-                result.At(i, k) * result.At(k, j);
+      const std::size_t n = rows_;
+      const std::size_t tile = kStarTileSize();
+      const std::size_t num_tiles = (n + tile - 1) / tile;
+      ThreadPool *pool = StarThreadPool();
+
+      auto tile_end = [n, tile](std::size_t t) { return std::min(n, (t + 1) * tile); };
+
+      for (std::size_t kt = 0; kt < num_tiles; ++kt) {
+        const std::size_t kb = kt * tile;
+        const std::size_t ke = tile_end(kt);
+
+        result.ClosureTile(kb, ke);
+
+        ParallelFor(pool, num_tiles, 1, [&](std::size_t it) {
+          if (it != kt) {
+            result.MultiplyRight(it * tile, tile_end(it), kb, ke);
           }
-        }
-        for (std::size_t i=0; i<rows_; ++i) {
-          if(i==k)
-            continue;
-          result.At(k, i) = result.At(k, k) * result.At(k,i);
-          //result.At(i, k) = result.At(i, k) * result.At(k,k);
-        }
+        });
+
+        ParallelFor(pool, num_tiles * num_tiles, 1, [&](std::size_t ij) {
+          const std::size_t it = ij / num_tiles;
+          const std::size_t jt = ij % num_tiles;
+          if (it != kt && jt != kt) {
+            result.AddTileProduct(it * tile, tile_end(it), jt * tile, tile_end(jt), kb, ke);
+          }
+        });
+
+        ParallelFor(pool, num_tiles, 1, [&](std::size_t jt) {
+          if (jt != kt) {
+            result.MultiplyLeft(kb, ke, jt * tile, tile_end(jt));
+          }
+        });
       }
 
       return result;
@@ -140,12 +210,12 @@ class Matrix {
 
     Matrix star() const {
       assert(columns_ == rows_);
-      return recursive_star2(*this);
+      return Star(IsScalar());
     }
 
     Matrix star2() const {
       assert(columns_ == rows_);
-      return FloydWarshall();
+      return Star2(IsScalar());
     }
 
     Matrix star3() const {
@@ -278,31 +348,155 @@ class Matrix {
     // (see "Handbook of Weighted Automata" chapter 2)
     static Matrix recursive_star2(Matrix matrix) {
       assert(matrix.rows_ == matrix.columns_);
+      matrix.RecursiveStarInPlace(0, matrix.rows_);
+      return matrix;
+    }
 
-      if (matrix.rows_ == 1) {
+    /*
+     * In-place version of recursive_star2 for the diagonal block [b, e) x [b, e):
+     * with a_11, a_12, a_21 and a_22 the four quarters of the block
+     *   as_11 = a_11^*, a = as_11 a_12, A_22 = (a_22 + a_21 a)^*,
+     *   A_21 = A_22 (a_21 as_11), A_12 = a A_22, A_11 = a A_21 + as_11
+     * The quarters are overwritten step by step (in this order), so no
+     * submatrices are copied.  The operations on the semiring elements are
+     * the same (and done in the same order) as in the version with copies.
+     */
+    void RecursiveStarInPlace(std::size_t b, std::size_t e) {
+      if (e - b == 1) {
         // just a scalar in a matrix
-        matrix.elements_[0] = matrix.elements_[0].star(); // use semiring-star
-        return matrix;
+        At(b, b) = At(b, b).star(); // use semiring-star
+        return;
       }
       //split in the "middle"
-      std::size_t split = matrix.columns_/2;
+      const std::size_t s = b + (e - b) / 2;
+
+      RecursiveStarInPlace(b, s);                  // a_11 = as_11
+      MultiplyLeft(b, s, s, e);                    // a_12 = a
+      AddProduct(s, e, s, e, b, s, false);         // a_22 = a_22 + a_21 a
+      RecursiveStarInPlace(s, e);                  // a_22 = A_22
+      MultiplyRight(s, e, b, s);                   // a_21 = a_21 as_11
+      MultiplyLeft(s, e, b, s);                    // a_21 = A_21
+      AddProduct(b, s, b, s, s, e, true);          // a_11 = A_11
+      MultiplyRight(b, s, s, e);                   // a_12 = A_12
+    }
 
-      Matrix a_11 = matrix.submatrix(0, split, 0, split);
-      Matrix a_12 = matrix.submatrix(split, matrix.columns_, 0, split);
-      Matrix a_21 = matrix.submatrix(0, split, split, matrix.rows_);
-      Matrix a_22 = matrix.submatrix(split, matrix.columns_, split, matrix.rows_);
+    /* Rows/columns of the tiles of the blocked algorithms. */
+    static std::size_t kStarTileSize() { return 64; }
 
-      Matrix as_11 = recursive_star2(a_11);
-      Matrix a = (as_11 * a_12);
+    /* Below this number of rows (or columns) the products of the star are
+     * not split into parallel tasks. */
+    static std::size_t kMinParallelRows() { return 16; }
 
-      Matrix A_22 = recursive_star2(a_22 + a_21 * a);
-      Matrix A_21 = A_22 * (a_21 * as_11);
+    /* The pool for the data parallel loops of the star, only semirings whose
+     * operations may be used concurrently get one. */
+    static ThreadPool* StarThreadPool() {
+      return IsThreadSafe<SR>::value ? SolverThreadPool() : nullptr;
+    }
 
-      Matrix A_12 = a * A_22;
-      Matrix A_11 = a * A_21 + as_11;
+    /* Scalar Floyd-Warshall on the diagonal tile [b, e) x [b, e). */
+    void ClosureTile(std::size_t b, std::size_t e) {
+      for (std::size_t k = b; k < e; ++k) {
+        At(k,k) = At(k, k).star();
+        for (std::size_t i = b; i < e; ++i) {
+          if(i==k)
+            continue;
+          At(i, k) = At(i, k) * At(k,k);
+          for (std::size_t j = b; j < e; ++j) {
+            if(j==k)
+              continue;
+            At(i, j) += At(i, k) * At(k, j);
+          }
+        }
+        for (std::size_t i = b; i < e; ++i) {
+          if(i==k)
+            continue;
+          At(k, i) = At(k, k) * At(k,i);
+        }
+      }
+    }
 
-      return block_matrix(std::move(A_11), std::move(A_12),
-                          std::move(A_21), std::move(A_22));
+    /* Entry (r, c) of the product of the blocks rows x [kb, ke) and
+     * [kb, ke) x columns. */
+    SR BlockProduct(std::size_t r, std::size_t c, std::size_t kb, std::size_t ke) const {
+      SR result = At(r, kb) * At(kb, c);
+      for (std::size_t k = kb + 1; k < ke; ++k) {
+        result += At(r, k) * At(k, c);
+      }
+      return result;
+    }
+
+    /* A[rb..re, mb..me] = A[rb..re, mb..me] * A[mb..me, mb..me] */
+    void MultiplyRight(std::size_t rb, std::size_t re, std::size_t mb, std::size_t me) {
+      auto multiply_row = [&](std::size_t r, std::vector<SR> &row) {
+        for (std::size_t c = mb; c < me; ++c) {
+          row[c - mb] = BlockProduct(r, c, mb, me);
+        }
+        std::move(row.begin(), row.end(), elements_.begin() + GetIndex(r, mb));
+      };
+      if (re - rb <= kMinParallelRows()) {
+        std::vector<SR> row(me - mb);
+        for (std::size_t r = rb; r < re; ++r) {
+          multiply_row(r, row);
+        }
+      } else {
+        ParallelFor(StarThreadPool(), re - rb, kMinParallelRows(), [&](std::size_t i) {
+          std::vector<SR> row(me - mb);
+          multiply_row(rb + i, row);
+        });
+      }
+    }
+
+    /* A[mb..me, cb..ce] = A[mb..me, mb..me] * A[mb..me, cb..ce] */
+    void MultiplyLeft(std::size_t mb, std::size_t me, std::size_t cb, std::size_t ce) {
+      auto multiply_column = [&](std::size_t c, std::vector<SR> &column) {
+        for (std::size_t r = mb; r < me; ++r) {
+          column[r - mb] = BlockProduct(r, c, mb, me);
+        }
+        for (std::size_t r = mb; r < me; ++r) {
+          At(r, c) = std::move(column[r - mb]);
+        }
+      };
+      if (ce - cb <= kMinParallelRows()) {
+        std::vector<SR> column(me - mb);
+        for (std::size_t c = cb; c < ce; ++c) {
+          multiply_column(c, column);
+        }
+      } else {
+        ParallelFor(StarThreadPool(), ce - cb, kMinParallelRows(), [&](std::size_t i) {
+          std::vector<SR> column(me - mb);
+          multiply_column(cb + i, column);
+        });
+      }
+    }
+
+    /* A[rb..re, cb..ce] = A[rb..re, kb..ke] * A[kb..ke, cb..ce] + A[rb..re, cb..ce]
+     * (or the sum in the other order if product_first is false).  The target
+     * must not overlap with the factors. */
+    void AddProduct(std::size_t rb, std::size_t re, std::size_t cb, std::size_t ce,
+                    std::size_t kb, std::size_t ke, bool product_first) {
+      auto add_row = [&](std::size_t r) {
+        for (std::size_t c = cb; c < ce; ++c) {
+          SR product = BlockProduct(r, c, kb, ke);
+          At(r, c) = product_first ? product + At(r, c) : At(r, c) + product;
+        }
+      };
+      ParallelFor(re - rb > kMinParallelRows() ? StarThreadPool() : nullptr,
+                  re - rb, kMinParallelRows(),
+                  [&](std::size_t i) { add_row(rb + i); });
+    }
+
+    /* A[rb..re, cb..ce] += A[rb..re, kb..ke] * A[kb..ke, cb..ce] for tiles of
+     * the blocked Floyd-Warshall, with the loops ordered for row-major access. */
+    void AddTileProduct(std::size_t rb, std::size_t re, std::size_t cb, std::size_t ce,
+                        std::size_t kb, std::size_t ke) {
+      for (std::size_t r = rb; r < re; ++r) {
+        for (std::size_t k = kb; k < ke; ++k) {
+          const SR &a_rk = At(r, k);
+          for (std::size_t c = cb; c < ce; ++c) {
+            At(r, c) += a_rk * At(k, c);
+          }
+        }
+      }
     }
 
     static Matrix block_matrix(Matrix &&a_11, Matrix &&a_12,
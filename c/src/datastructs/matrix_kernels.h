@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "../semirings/semiring.h"
+#include "../utils/thread_pool.h"
+
+/*
+ * Matrix operations for semirings whose elements are a single scalar (see
+ * ScalarSemiring in semiring.h).  The matrices are unpacked into plain
+ * row-major arrays of the scalars, so that the inner loops neither go through
+ * the virtual interface of the semiring nor through its infinity checks for
+ * every single operation.  All inner loops are instances of
+ * ScalarSemiring<SR>::AddScaledRow, which the semirings vectorize.
+ *
+ * Matrix only uses Multiply and Star on the elements, so a semiring can
+ * replace the whole class by a specialization with a different
+ * representation (see the one for BoolSemiring in bool-semiring.h).
+ */
+template <typename SR>
+class ScalarMatrixKernels {
+  typedef ScalarSemiring<SR> Traits;
+
+  public:
+    typedef typename Traits::Scalar Scalar;
+
+    /* The product of the row-major matrices A (rows x inner) and B (inner x
+     * columns). */
+    static std::vector<SR> Multiply(const std::vector<SR> &A, const std::vector<SR> &B,
+                                    std::size_t rows, std::size_t inner,
+                                    std::size_t columns) {
+      return Unpack(Multiply(Pack(A), Pack(B), rows, inner, columns));
+    }
+
+    /* The star of the row-major n x n matrix A. */
+    static std::vector<SR> Star(const std::vector<SR> &A, std::size_t n) {
+      auto values = Pack(A);
+      Closure(values, n);
+      return Unpack(values);
+    }
+
+    static std::vector<Scalar> Pack(const std::vector<SR> &elements) {
+      std::vector<Scalar> result;
+      result.reserve(elements.size());
+      for (const auto &elem : elements) {
+        result.push_back(Traits::Get(elem));
+      }
+      return result;
+    }
+
+    static std::vector<SR> Unpack(const std::vector<Scalar> &values) {
+      std::vector<SR> result;
+      result.reserve(values.size());
+      for (const auto &value : values) {
+        result.emplace_back(Traits::Make(value));
+      }
+      return result;
+    }
+
+    /* C = A B for row-major A (rows x inner) and B (inner x columns).  Every
+     * entry is accumulated in the same order as in Matrix::operator*. */
+    static std::vector<Scalar> Multiply(const std::vector<Scalar> &A,
+                                        const std::vector<Scalar> &B,
+                                        std::size_t rows, std::size_t inner,
+                                        std::size_t columns) {
+      assert(A.size() == rows * inner && B.size() == inner * columns);
+      std::vector<Scalar> C(rows * columns);
+      ParallelFor(GetThreadPool(), rows, kMinParallelRows(), [&](std::size_t r) {
+        Scalar *row = &C[r * columns];
+        const Scalar a = A[r * inner];
+        for (std::size_t c = 0; c < columns; ++c) {
+          row[c] = Traits::Mul(a, B[c]);
+        }
+        for (std::size_t k = 1; k < inner; ++k) {
+          Traits::AddScaledRow(row, A[r * inner + k], &B[k * columns], columns);
+        }
+      });
+      return C;
+    }
+
+    /*
+     * A = A^* for the row-major n x n matrix A.  This is the blocked
+     * Floyd-Warshall algorithm of Matrix::FloydWarshall: for every diagonal
+     * tile K
+     *   A_KK = A_KK^*, A_IK = A_IK A_KK, A_IJ += A_IK A_KJ, A_KJ = A_KK A_KJ
+     * for all I, J != K, where the last three steps are done in parallel
+     * (by rows of tiles, resp. columns of tiles for the last one).
+     */
+    static void Closure(std::vector<Scalar> &A, std::size_t n) {
+      assert(A.size() == n * n);
+      const std::size_t tile = kTileSize();
+      const std::size_t num_tiles = (n + tile - 1) / tile;
+      ThreadPool *pool = GetThreadPool();
+      auto tile_end = [n, tile](std::size_t t) { return std::min(n, (t + 1) * tile); };
+
+      for (std::size_t kt = 0; kt < num_tiles; ++kt) {
+        const std::size_t kb = kt * tile;
+        const std::size_t ke = tile_end(kt);
+        const std::size_t width = ke - kb;
+
+        ClosureTile(A, n, kb, ke);
+
+        // A_IK = A_IK A_KK, row by row
+        ParallelFor(pool, n, kMinParallelRows(), [&](std::size_t r) {
+          if (kb <= r && r < ke) {
+            return;
+          }
+          std::vector<Scalar> row(width);
+          const Scalar a = A[r * n + kb];
+          for (std::size_t c = 0; c < width; ++c) {
+            row[c] = Traits::Mul(a, A[kb * n + kb + c]);
+          }
+          for (std::size_t k = kb + 1; k < ke; ++k) {
+            Traits::AddScaledRow(&row[0], A[r * n + k], &A[k * n + kb], width);
+          }
+          std::copy(row.begin(), row.end(), A.begin() + r * n + kb);
+        });
+
+        // A_IJ += A_IK A_KJ, tile by tile so that A_KJ stays in the cache
+        ParallelFor(pool, num_tiles, 1, [&](std::size_t it) {
+          if (it == kt) {
+            return;
+          }
+          for (std::size_t jt = 0; jt < num_tiles; ++jt) {
+            if (jt == kt) {
+              continue;
+            }
+            const std::size_t jb = jt * tile;
+            const std::size_t je = tile_end(jt);
+            for (std::size_t r = it * tile; r < tile_end(it); ++r) {
+              for (std::size_t k = kb; k < ke; ++k) {
+                Traits::AddScaledRow(&A[r * n + jb], A[r * n + k], &A[k * n + jb], je - jb);
+              }
+            }
+          }
+        });
+
+        // A_KJ = A_KK A_KJ, by tiles of columns (all rows of K are needed
+        // before they are overwritten)
+        ParallelFor(pool, num_tiles, 1, [&](std::size_t jt) {
+          if (jt == kt) {
+            return;
+          }
+          const std::size_t jb = jt * tile;
+          const std::size_t je = tile_end(jt);
+          std::vector<Scalar> block(width * (je - jb));
+          for (std::size_t r = kb; r < ke; ++r) {
+            Scalar *row = &block[(r - kb) * (je - jb)];
+            const Scalar a = A[r * n + kb];
+            for (std::size_t c = jb; c < je; ++c) {
+              row[c - jb] = Traits::Mul(a, A[kb * n + c]);
+            }
+            for (std::size_t k = kb + 1; k < ke; ++k) {
+              Traits::AddScaledRow(row, A[r * n + k], &A[k * n + jb], je - jb);
+            }
+          }
+          for (std::size_t r = kb; r < ke; ++r) {
+            std::copy(block.begin() + (r - kb) * (je - jb),
+                      block.begin() + (r - kb + 1) * (je - jb),
+                      A.begin() + r * n + jb);
+          }
+        });
+      }
+    }
+
+  private:
+    static std::size_t kTileSize() { return 64; }
+    static std::size_t kMinParallelRows() { return 16; }
+
+    static ThreadPool* GetThreadPool() {
+      return IsThreadSafe<SR>::value ? SolverThreadPool() : nullptr;
+    }
+
+    /* Scalar Floyd-Warshall on the diagonal tile [b, e) x [b, e). */
+    static void ClosureTile(std::vector<Scalar> &A, std::size_t n,
+                            std::size_t b, std::size_t e) {
+      Scalar *a = A.data();
+      for (std::size_t k = b; k < e; ++k) {
+        const Scalar star = Traits::Star(A[k * n + k]);
+        A[k * n + k] = star;
+        for (std::size_t i = b; i < e; ++i) {
+          if (i == k) {
+            continue;
+          }
+          const Scalar a_ik = Traits::Mul(A[i * n + k], star);
+          A[i * n + k] = a_ik;
+          Traits::AddScaledRow(a + i * n + b, a_ik, a + k * n + b, k - b);
+          Traits::AddScaledRow(a + i * n + k + 1, a_ik, a + k * n + k + 1, e - k - 1);
+        }
+        for (std::size_t j = b; j < e; ++j) {
+          if (j != k) {
+            A[k * n + j] = Traits::Mul(star, A[k * n + j]);
+          }
+        }
+      }
+    }
+};
+
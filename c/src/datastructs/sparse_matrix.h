@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "matrix.h"
+
+/*
+ * The nonzero structure of a sparse matrix in compressed sparse row (CSR)
+ * format: the nonzero entries of row r are stored at the positions
+ * row_begin[r] to row_begin[r+1]-1, position p holds the entry in column
+ * column_index[p].  Within a row the columns are sorted.
+ *
+ * A pattern is never modified after construction, so it can be shared between
+ * several matrices (e.g., all the evaluations of a symbolic matrix).
+ */
+class SparsePattern {
+  public:
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    SparsePattern(std::size_t rows, std::size_t columns,
+                  std::vector<std::size_t> &&row_begin,
+                  std::vector<std::size_t> &&column_index)
+        : rows_(rows), columns_(columns), row_begin_(std::move(row_begin)),
+          column_index_(std::move(column_index)), diagonal_(rows) {
+      assert(row_begin_.size() == rows_ + 1);
+      assert(row_begin_.back() == column_index_.size());
+      for (std::size_t r = 0; r < rows_; ++r) {
+        assert(std::is_sorted(column_index_.begin() + row_begin_[r],
+                              column_index_.begin() + row_begin_[r + 1]));
+        diagonal_[r] = Find(r, r);
+      }
+    }
+
+    std::size_t getRows() const { return rows_; }
+    std::size_t getColumns() const { return columns_; }
+    std::size_t getNonZeros() const { return column_index_.size(); }
+
+    std::size_t RowBegin(std::size_t r) const { return row_begin_[r]; }
+    std::size_t RowEnd(std::size_t r) const { return row_begin_[r + 1]; }
+    std::size_t Column(std::size_t p) const { return column_index_[p]; }
+
+    /* Position of the diagonal entry of row r (or npos if it is zero). */
+    std::size_t Diagonal(std::size_t r) const { return diagonal_[r]; }
+
+    /* Position of the entry (r, c) or npos if it is not in the pattern. */
+    std::size_t Find(std::size_t r, std::size_t c) const {
+      auto begin = column_index_.begin() + row_begin_[r];
+      auto end = column_index_.begin() + row_begin_[r + 1];
+      auto iter = std::lower_bound(begin, end, c);
+      if (iter == end || *iter != c) {
+        return npos;
+      }
+      return iter - column_index_.begin();
+    }
+
+    /*
+     * Symbolic analysis for the LDU decomposition (see
+     * SparseMatrix::LDU_decomposition): computes the structure of the packed
+     * factors, i.e., this pattern together with the diagonal and all the
+     * fill-in created by the elimination in the natural order.
+     *
+     * Row i of the factors contains the entries of row i of A and the strictly
+     * upper part of every row k of the factors, where k ranges over the
+     * (already extended) strictly lower part of row i.
+     */
+    std::shared_ptr<const SparsePattern> LDU_pattern() const {
+      assert(rows_ == columns_);
+      const std::size_t n = rows_;
+
+      std::vector<std::size_t> row_begin{0};
+      std::vector<std::size_t> column_index;
+      std::vector<std::size_t> diagonal(n);
+
+      // marker[c] == i iff column c is already in row i
+      std::vector<std::size_t> marker(n, n);
+      std::vector<std::size_t> row;
+      std::priority_queue<std::size_t, std::vector<std::size_t>,
+                          std::greater<std::size_t> > lower;
+
+      for (std::size_t i = 0; i < n; ++i) {
+        row.clear();
+        auto insert = [&](std::size_t c) {
+          if (marker[c] != i) {
+            marker[c] = i;
+            row.push_back(c);
+            if (c < i) {
+              lower.push(c);
+            }
+          }
+        };
+
+        insert(i);
+        for (std::size_t p = RowBegin(i); p < RowEnd(i); ++p) {
+          insert(Column(p));
+        }
+        while (!lower.empty()) {
+          std::size_t k = lower.top();
+          lower.pop();
+          for (std::size_t p = diagonal[k] + 1; p < row_begin[k + 1]; ++p) {
+            insert(column_index[p]);
+          }
+        }
+
+        std::sort(row.begin(), row.end());
+        diagonal[i] = column_index.size() +
+          (std::lower_bound(row.begin(), row.end(), i) - row.begin());
+        column_index.insert(column_index.end(), row.begin(), row.end());
+        row_begin.push_back(column_index.size());
+      }
+
+      return std::make_shared<const SparsePattern>(
+          n, n, std::move(row_begin), std::move(column_index));
+    }
+
+  private:
+    std::size_t rows_;
+    std::size_t columns_;
+    std::vector<std::size_t> row_begin_;
+    std::vector<std::size_t> column_index_;
+    std::vector<std::size_t> diagonal_;
+};
+
+
+/*
+ * Sparse matrix over SR.  All entries that are not in the pattern are
+ * SR::null().
+ */
+template <typename SR>
+class SparseMatrix {
+  public:
+    SparseMatrix(std::shared_ptr<const SparsePattern> pattern,
+                 std::vector<SR> &&values)
+        : pattern_(std::move(pattern)), values_(std::move(values)) {
+      assert(pattern_->getNonZeros() == values_.size());
+    }
+
+    SparseMatrix(std::shared_ptr<const SparsePattern> pattern,
+                 const std::vector<SR> &values)
+        : pattern_(std::move(pattern)), values_(values) {
+      assert(pattern_->getNonZeros() == values_.size());
+    }
+
+    /* Convert a dense matrix, only entries different from SR::null() are
+     * stored. */
+    explicit SparseMatrix(const Matrix<SR> &matrix) {
+      std::vector<std::size_t> row_begin{0};
+      std::vector<std::size_t> column_index;
+      for (std::size_t r = 0; r < matrix.getRows(); ++r) {
+        for (std::size_t c = 0; c < matrix.getColumns(); ++c) {
+          if (!(matrix.At(r, c) == SR::null())) {
+            column_index.push_back(c);
+            values_.push_back(matrix.At(r, c));
+          }
+        }
+        row_begin.push_back(column_index.size());
+      }
+      pattern_ = std::make_shared<const SparsePattern>(
+          matrix.getRows(), matrix.getColumns(),
+          std::move(row_begin), std::move(column_index));
+    }
+
+    const SparsePattern& getPattern() const { return *pattern_; }
+    const std::shared_ptr<const SparsePattern>& getPatternPtr() const { return pattern_; }
+
+    std::size_t getRows() const { return pattern_->getRows(); }
+    std::size_t getColumns() const { return pattern_->getColumns(); }
+
+    const std::vector<SR>& getValues() const { return values_; }
+
+    Matrix<SR> ToDense() const {
+      Matrix<SR> result{getRows(), getColumns()};
+      for (std::size_t r = 0; r < getRows(); ++r) {
+        for (std::size_t p = pattern_->RowBegin(r); p < pattern_->RowEnd(r); ++p) {
+          result.At(r, pattern_->Column(p)) = values_[p];
+        }
+      }
+      return result;
+    }
+
+    /*
+     * Sparse version of Matrix::LDU_decomposition_2: computes the packed
+     * factors (L, D^*, U) of A such that A^* = U^* D^* L^*.  ldu_pattern must
+     * be the result of A.getPattern().LDU_pattern().  The operations are done
+     * in the same order as in the dense version, we only skip the ones where
+     * one of the operands is structurally zero.
+     */
+    static SparseMatrix LDU_decomposition(
+        const SparseMatrix &A, const std::shared_ptr<const SparsePattern> &ldu_pattern) {
+      const SparsePattern &a = A.getPattern();
+      const SparsePattern &f = *ldu_pattern;
+      assert(a.getRows() == a.getColumns());
+      assert(f.getRows() == a.getRows() && f.getColumns() == a.getColumns());
+      const std::size_t n = a.getRows();
+
+      std::vector<SR> values(f.getNonZeros(), SR::null());
+      // dense accumulator for the current row
+      std::vector<SR> row(n, SR::null());
+
+      for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t p = a.RowBegin(i); p < a.RowEnd(i); ++p) {
+          row[a.Column(p)] = A.values_[p];
+        }
+
+        // the strictly lower part of row i is processed in increasing order,
+        // so row[k] is final when it is used
+        for (std::size_t p = f.RowBegin(i); p < f.Diagonal(i); ++p) {
+          const std::size_t k = f.Column(p);
+          for (std::size_t q = f.Diagonal(k) + 1; q < f.RowEnd(k); ++q) {
+            row[f.Column(q)] += row[k] * values[q];
+          }
+        }
+
+        for (std::size_t p = f.RowBegin(i); p < f.Diagonal(i); ++p) {
+          const std::size_t j = f.Column(p);
+          values[p] = row[j] * values[f.Diagonal(j)];
+        }
+
+        const SR d = row[i].star();
+        values[f.Diagonal(i)] = d;
+
+        for (std::size_t p = f.Diagonal(i) + 1; p < f.RowEnd(i); ++p) {
+          values[p] = d * row[f.Column(p)];
+        }
+
+        for (std::size_t p = f.RowBegin(i); p < f.RowEnd(i); ++p) {
+          row[f.Column(p)] = SR::null();
+        }
+      }
+
+      return SparseMatrix{ldu_pattern, std::move(values)};
+    }
+
+    /* Sparse version of Matrix::subst_LDU: solves x = Ax + rhs given the
+     * packed LDU factors of A. */
+    static Matrix<SR> subst_LDU(const SparseMatrix &A_LDU, Matrix<SR> rhs) {
+      const SparsePattern &f = A_LDU.getPattern();
+      assert(rhs.getColumns() == 1 && rhs.getRows() == f.getRows());
+      const std::size_t n = f.getRows();
+      const std::vector<SR> &values = A_LDU.values_;
+
+      // forward substitution with the strictly lower part
+      for (std::size_t i = 1; i < n; ++i) {
+        for (std::size_t p = f.RowBegin(i); p < f.Diagonal(i); ++p) {
+          rhs.At(i, 0) += values[p] * rhs.At(f.Column(p), 0);
+        }
+      }
+      for (std::size_t i = 0; i < n; ++i) {
+        rhs.At(i, 0) = values[f.Diagonal(i)] * rhs.At(i, 0); // diagonal is already starred!
+      }
+      // backward substitution with the strictly upper part
+      for (std::size_t i = n; i-- > 0; ) {
+        for (std::size_t p = f.Diagonal(i) + 1; p < f.RowEnd(i); ++p) {
+          rhs.At(i, 0) += values[p] * rhs.At(f.Column(p), 0);
+        }
+      }
+      return rhs;
+    }
+
+    // solves x = Ax + b, i.e., computes A^* b without computing A^*
+    Matrix<SR> solve_LDU(const Matrix<SR> &b) const {
+      return subst_LDU(LDU_decomposition(*this, pattern_->LDU_pattern()), b);
+    }
+
+  private:
+    std::shared_ptr<const SparsePattern> pattern_;
+    std::vector<SR> values_;
+};
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sparse_matrix.h"
+
+/*
+ * Fill-reducing orderings for the (structurally symmetrized) nonzero pattern
+ * of a square matrix.  An ordering is a permutation "order" such that
+ * order[k] is the (old) index of the row/column that is moved to position k.
+ *
+ * The star and the LDU decomposition of a matrix create fill-in depending on
+ * the order of the rows/columns, so permuting the equations (and variables)
+ * before the factorization can reduce both the numeric work and the size of
+ * the free semiring elements of the symbolic solvers considerably.
+ */
+enum class VariableOrdering {
+  None,                   // keep the order of the input
+  ReverseCuthillMcKee,    // reduce the bandwidth/profile
+  MinimumDegree           // greedily eliminate the vertex of minimum degree
+};
+
+/* Process wide ordering that is used by the Newton solvers (see
+ * GenericNewton::solve_fixpoint).  It is only set before solving, e.g., from
+ * the command line. */
+inline VariableOrdering& DefaultVariableOrdering() {
+  static VariableOrdering ordering = VariableOrdering::None;
+  return ordering;
+}
+
+/* Parses the name used on the command line, returns false if it is unknown. */
+inline bool ParseVariableOrdering(const std::string &name, VariableOrdering &ordering) {
+  if (name == "none") {
+    ordering = VariableOrdering::None;
+  } else if (name == "rcm") {
+    ordering = VariableOrdering::ReverseCuthillMcKee;
+  } else if (name == "mindegree") {
+    ordering = VariableOrdering::MinimumDegree;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/* Adjacency lists of the undirected graph of A + A^T without self loops, the
+ * neighbours of every vertex are sorted. */
+inline std::vector< std::vector<std::size_t> >
+SymmetricAdjacency(const SparsePattern &pattern) {
+  assert(pattern.getRows() == pattern.getColumns());
+  const std::size_t n = pattern.getRows();
+  std::vector< std::vector<std::size_t> > adjacency(n);
+  for (std::size_t r = 0; r < n; ++r) {
+    for (std::size_t p = pattern.RowBegin(r); p < pattern.RowEnd(r); ++p) {
+      const std::size_t c = pattern.Column(p);
+      if (c != r) {
+        adjacency[r].push_back(c);
+        adjacency[c].push_back(r);
+      }
+    }
+  }
+  for (auto &neighbours : adjacency) {
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()),
+                     neighbours.end());
+  }
+  return adjacency;
+}
+
+/*
+ * Reverse Cuthill-McKee: every connected component is numbered by a breadth
+ * first search, where the neighbours of a vertex are visited by increasing
+ * degree, starting from a pseudo-peripheral vertex (found by the heuristic of
+ * George and Liu).  The resulting order is reversed.
+ */
+inline std::vector<std::size_t> ReverseCuthillMcKeeOrdering(const SparsePattern &pattern) {
+  const auto adjacency = SymmetricAdjacency(pattern);
+  const std::size_t n = adjacency.size();
+
+  auto by_degree = [&adjacency](std::size_t a, std::size_t b) {
+    return adjacency[a].size() < adjacency[b].size() ||
+           (adjacency[a].size() == adjacency[b].size() && a < b);
+  };
+
+  // level[v] == n means that v is not reached (yet)
+  std::vector<std::size_t> level(n, n);
+  // breadth first search from start within the unnumbered vertices, appends
+  // the vertices to order and returns the index in order of the last level
+  auto bfs = [&](std::size_t start, std::vector<std::size_t> &order,
+                 const std::vector<bool> &numbered) {
+    const std::size_t begin = order.size();
+    order.push_back(start);
+    level[start] = 0;
+    std::size_t last_level = begin;
+    std::vector<std::size_t> next;
+    for (std::size_t i = begin; i < order.size(); ++i) {
+      const std::size_t v = order[i];
+      if (level[v] != level[order[last_level]]) {
+        last_level = i;
+      }
+      next.clear();
+      for (auto u : adjacency[v]) {
+        if (!numbered[u] && level[u] == n) {
+          level[u] = level[v] + 1;
+          next.push_back(u);
+        }
+      }
+      std::sort(next.begin(), next.end(), by_degree);
+      order.insert(order.end(), next.begin(), next.end());
+    }
+    return last_level;
+  };
+
+  std::vector<std::size_t> vertices(n);
+  for (std::size_t v = 0; v < n; ++v) {
+    vertices[v] = v;
+  }
+  std::sort(vertices.begin(), vertices.end(), by_degree);
+
+  std::vector<bool> numbered(n, false);
+  std::vector<std::size_t> order;
+  order.reserve(n);
+  std::vector<std::size_t> component;
+
+  for (auto start : vertices) {
+    if (numbered[start]) {
+      continue;
+    }
+
+    // look for a pseudo-peripheral vertex: restart the search from a vertex of
+    // minimum degree in the last level as long as the eccentricity grows
+    std::size_t eccentricity = 0;
+    while (true) {
+      component.clear();
+      const std::size_t last_level = bfs(start, component, numbered);
+      const std::size_t new_eccentricity = level[component.back()];
+      const std::size_t candidate = *std::min_element(
+          component.begin() + last_level, component.end(), by_degree);
+      for (auto v : component) {
+        level[v] = n;
+      }
+      if (new_eccentricity <= eccentricity && eccentricity != 0) {
+        break;
+      }
+      eccentricity = new_eccentricity;
+      if (eccentricity == 0 || candidate == start) {
+        break;
+      }
+      start = candidate;
+    }
+
+    component.clear();
+    bfs(start, component, numbered);
+    for (auto v : component) {
+      numbered[v] = true;
+    }
+    order.insert(order.end(), component.begin(), component.end());
+  }
+
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+/*
+ * Minimum degree: simulates the elimination on the graph of A + A^T and always
+ * eliminates a vertex of minimum degree next (ties are broken by the index to
+ * keep the result deterministic).  Eliminating a vertex turns its neighbours
+ * into a clique, i.e., adds exactly the fill-in edges of the factorization.
+ */
+inline std::vector<std::size_t> MinimumDegreeOrdering(const SparsePattern &pattern) {
+  const auto adjacency_lists = SymmetricAdjacency(pattern);
+  const std::size_t n = adjacency_lists.size();
+
+  std::vector< std::set<std::size_t> > adjacency(n);
+  std::set< std::pair<std::size_t, std::size_t> > queue; // (degree, vertex)
+  for (std::size_t v = 0; v < n; ++v) {
+    adjacency[v].insert(adjacency_lists[v].begin(), adjacency_lists[v].end());
+    queue.insert(std::make_pair(adjacency[v].size(), v));
+  }
+
+  std::vector<std::size_t> order;
+  order.reserve(n);
+  while (!queue.empty()) {
+    const std::size_t v = queue.begin()->second;
+    queue.erase(queue.begin());
+    order.push_back(v);
+
+    const std::vector<std::size_t> neighbours(adjacency[v].begin(), adjacency[v].end());
+    for (auto u : neighbours) {
+      queue.erase(std::make_pair(adjacency[u].size(), u));
+      adjacency[u].erase(v);
+    }
+    for (auto u : neighbours) {
+      for (auto w : neighbours) {
+        if (u != w) {
+          adjacency[u].insert(w);
+        }
+      }
+    }
+    for (auto u : neighbours) {
+      queue.insert(std::make_pair(adjacency[u].size(), u));
+    }
+    adjacency[v].clear();
+  }
+  return order;
+}
+
+inline std::vector<std::size_t> ComputeOrdering(const SparsePattern &pattern,
+                                                VariableOrdering ordering) {
+  switch (ordering) {
+    case VariableOrdering::ReverseCuthillMcKee:
+      return ReverseCuthillMcKeeOrdering(pattern);
+    case VariableOrdering::MinimumDegree:
+      return MinimumDegreeOrdering(pattern);
+    case VariableOrdering::None:
+    default: {
+      std::vector<std::size_t> order(pattern.getRows());
+      for (std::size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+      }
+      return order;
+    }
+  }
+}
@@ -1,5 +1,6 @@
 #include "var.h"
 
+std::mutex Var::mutex_;
 VarId Var::next_id_ = 0;
 
 std::unordered_map<std::string, VarId> Var::name_to_id_;
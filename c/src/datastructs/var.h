@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <unordered_map>
@@ -76,33 +77,26 @@ class Var {
   public:
 
     static VarId GetVarId() {
+      std::lock_guard<std::mutex> lock(mutex_);
       std::stringstream ss;
       /* Prefix auto-generated variables with underscore. */
       ss << "_" << next_id_.GetRawId();
-      /* GetVarId(std::string) will use next_id_ and create the new mappings. */
-      return GetVarId(ss.str());
+      /* GetVarIdUnlocked(std::string) will use next_id_ and create the new
+       * mappings. */
+      return GetVarIdUnlocked(ss.str());
     }
 
     static VarId GetVarId(const std::string &name) {
-      auto iter = name_to_id_.find(name);
-      /* Var exists, return reference to it. */
-      if (iter != name_to_id_.end()) {
-        return iter->second;
-      }
-
-      /* Var doesn't exists, create a new one. */
-      std::unique_ptr<Var> var{new Var(next_id_, name)};
-      ++next_id_;
-      auto iter_inserted = id_to_var_.emplace(var->GetId(), std::move(var));
-      assert(iter_inserted.second);
-      auto &inserted_var = iter_inserted.first->second;
-      name_to_id_.emplace(inserted_var->GetName(), inserted_var->GetId());
-      return inserted_var->GetId();
+      std::lock_guard<std::mutex> lock(mutex_);
+      return GetVarIdUnlocked(name);
     }
 
     static const Var& GetVar(const VarId vid) {
+      std::lock_guard<std::mutex> lock(mutex_);
       auto iter = id_to_var_.find(vid);
       assert(iter != id_to_var_.end());
+      /* The Var itself is owned by a unique_ptr, so the reference stays valid
+       * even if the map is rehashed by another thread. */
       return *iter->second;
     }
 
@@ -130,6 +124,26 @@ class Var {
     VarId id_;
     std::string name_;
 
+    static VarId GetVarIdUnlocked(const std::string &name) {
+      auto iter = name_to_id_.find(name);
+      /* Var exists, return reference to it. */
+      if (iter != name_to_id_.end()) {
+        return iter->second;
+      }
+
+      /* Var doesn't exists, create a new one. */
+      std::unique_ptr<Var> var{new Var(next_id_, name)};
+      ++next_id_;
+      auto iter_inserted = id_to_var_.emplace(var->GetId(), std::move(var));
+      assert(iter_inserted.second);
+      auto &inserted_var = iter_inserted.first->second;
+      name_to_id_.emplace(inserted_var->GetName(), inserted_var->GetId());
+      return inserted_var->GetId();
+    }
+
+    /* Protects the maps below, variables can be created by several solver
+     * threads at the same time. */
+    static std::mutex mutex_;
     static VarId next_id_;
     static std::unordered_map<std::string, VarId> name_to_id_;
     static std::unordered_map<VarId, std::unique_ptr<Var> > id_to_var_;
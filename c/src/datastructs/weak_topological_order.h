@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cassert>
+#include <limits>
+#include <vector>
+
+/*
+ * Weak topological ordering of a directed graph (F. Bourdoncle, "Efficient
+ * chaotic iteration strategies with widenings", 1993): a hierarchical
+ * decomposition of the vertices into nested components, each with a head,
+ * such that every edge u -> v goes forward in the order (u before v) unless v
+ * is the head of a component that contains u.  So every cycle passes through
+ * the head of a component containing it, and iterating every component until
+ * its head is stable (the recursive iteration strategy) reaches a fixpoint.
+ *
+ * The order is stored flat: Vertex(p) is the vertex at position p, and if it
+ * is the head of a component, the component consists of the positions p to
+ * ComponentEnd(p)-1 (otherwise ComponentEnd(p) is p+1).  A vertex with a self
+ * loop is the head of a component without any other elements.
+ */
+class WeakTopologicalOrder {
+  public:
+    /* successors[v] are the targets of the edges leaving v. */
+    explicit WeakTopologicalOrder(const std::vector< std::vector<std::size_t> > &successors)
+        : successors_(&successors), dfn_(successors.size(), 0), num_(0) {
+      const std::size_t n = successors.size();
+      // the partitions are built back to front (Bourdoncle prepends every
+      // element), so reversed_ holds the order in reverse and component_begin_
+      // the index in reversed_ where the component of a head started
+      reversed_.reserve(n);
+      component_begin_.reserve(n);
+      for (std::size_t v = 0; v < n; ++v) {
+        if (dfn_[v] == 0) {
+          Visit(v);
+        }
+      }
+      assert(reversed_.size() == n);
+
+      order_.resize(n);
+      component_end_.resize(n);
+      head_.resize(n);
+      for (std::size_t r = 0; r < n; ++r) {
+        const std::size_t p = n - 1 - r;
+        order_[p] = reversed_[r];
+        component_end_[p] = n - component_begin_[r];
+        head_[p] = reversed_head_[r];
+      }
+      successors_ = nullptr;
+      dfn_.clear();
+      reversed_.clear();
+      reversed_head_.clear();
+      component_begin_.clear();
+    }
+
+    std::size_t size() const { return order_.size(); }
+
+    std::size_t Vertex(std::size_t p) const { return order_[p]; }
+
+    bool IsHead(std::size_t p) const { return head_[p]; }
+
+    std::size_t ComponentEnd(std::size_t p) const { return component_end_[p]; }
+
+  private:
+    static std::size_t Done() { return std::numeric_limits<std::size_t>::max(); }
+
+    /* Bourdoncle's recursive Visit and Component, with an explicit stack of
+     * frames instead of recursion (the recursion is as deep as the longest
+     * path, which overflows the call stack for large systems).  A frame is
+     * first a call of Visit(vertex); if vertex turns out to be the head of a
+     * component, the same frame continues as Component(vertex) and returns
+     * head when that is done. */
+    struct Frame {
+      std::size_t vertex;
+      std::size_t next_successor;
+      std::size_t head;
+      bool loop;
+      bool component;
+      std::size_t begin;  // of the component in reversed_
+    };
+
+    void Visit(std::size_t root) {
+      std::vector<Frame> frames;
+      auto call = [this, &frames](std::size_t v) {
+        stack_.push_back(v);
+        dfn_[v] = ++num_;
+        frames.push_back(Frame{v, 0, dfn_[v], false, false, 0});
+      };
+      call(root);
+      while (!frames.empty()) {
+        Frame &frame = frames.back();
+        const std::vector<std::size_t> &successors = (*successors_)[frame.vertex];
+        bool called = false;
+        while (frame.next_successor < successors.size() && !called) {
+          const std::size_t w = successors[frame.next_successor++];
+          if (dfn_[w] == 0) {
+            call(w);  // invalidates frame
+            called = true;
+          } else if (!frame.component && dfn_[w] <= frame.head) {
+            frame.head = dfn_[w];
+            frame.loop = true;
+          }
+        }
+        if (called) {
+          continue;
+        }
+
+        const std::size_t v = frame.vertex;
+        if (frame.component) {
+          reversed_.push_back(v);
+          reversed_head_.push_back(true);
+          component_begin_.push_back(frame.begin);
+        } else if (frame.head == dfn_[v]) {
+          dfn_[v] = Done();
+          std::size_t element = stack_.back();
+          stack_.pop_back();
+          if (frame.loop) {
+            while (element != v) {
+              dfn_[element] = 0;
+              element = stack_.back();
+              stack_.pop_back();
+            }
+            frame.component = true;
+            frame.next_successor = 0;
+            frame.begin = reversed_.size();
+            continue;
+          }
+          reversed_.push_back(v);
+          reversed_head_.push_back(false);
+          component_begin_.push_back(reversed_.size() - 1);
+        }
+
+        // return head to the caller (Component ignores it)
+        const std::size_t head = frame.head;
+        frames.pop_back();
+        if (!frames.empty() && !frames.back().component && head <= frames.back().head) {
+          frames.back().head = head;
+          frames.back().loop = true;
+        }
+      }
+    }
+
+    // only used during the construction
+    const std::vector< std::vector<std::size_t> > *successors_;
+    std::vector<std::size_t> dfn_;
+    std::size_t num_;
+    std::vector<std::size_t> stack_;
+    std::vector<std::size_t> reversed_;
+    std::vector<bool> reversed_head_;
+    std::vector<std::size_t> component_begin_;
+
+    std::vector<std::size_t> order_;
+    std::vector<std::size_t> component_end_;
+    std::vector<bool> head_;
+};
@@ -67,6 +67,8 @@ void check_all_equal_commutative(const std::string& startsymbol, const std::vect
 
   bool all_equal = true;
   for(int i=1; i<num_grammars; i++) {
+    // the free equations of the previous grammar are not needed anymore
+    FreeSemiring::GC();
     auto equations = MakeCommEquationsAndMap(p.free_parser(inputs[i]), [](const FreeSemiring &c) -> SR {
       auto srconv = SRConverter<SR>();
       return c.Eval(srconv);
@@ -134,6 +136,8 @@ void check_all_equal_lossy(const std::string& startsymbol, const std::vector<std
 
   bool all_equal = true;
   for(int i=1; i<num_grammars; i++) {
+    // the free equations of the previous grammar are not needed anymore
+    FreeSemiring::GC();
 
     auto eq_tmp2 = MapEquations(p.free_parser(inputs[i]), [](const FreeSemiring &c) -> LossyFiniteAutomaton {
       auto srconv = SRConverter<LossyFiniteAutomaton>();
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <numeric>
 #include <string>
+#include <type_traits>
 
 #include <boost/program_options.hpp>
 
@@ -14,6 +15,7 @@
 #include "polynomials/non_commutative_polynomial.h"
 
 #include "semirings/commutativeRExp.h"
+#include "semirings/free-semiring-cache.h"
 #include "semirings/float-semiring.h"
 #include "semirings/prec-rat-semiring.h"
 #include "semirings/tropical-semiring.h"
@@ -37,39 +39,76 @@
 
 
 #include "solvers/newton_generic.h"
+#include "solvers/chaotic_iteration.h"
+#include "solvers/horn.h"
 #include "solvers/kleene_seminaive.h"
+#include "solvers/knuth.h"
 #include "solvers/solver_utils.h"
 
 #include "utils/string_util.h"
 
 
+// solvers that only exist for some semirings (and only for commutative
+// polynomials), the last argument tells whether SolverType is available,
+// otherwise we use the default solver
+template <template <typename> class SolverType, typename SR, template <typename> class Poly>
+ValuationMap<SR> call_restricted_solver(const std::string solver_title, const GenericEquations<Poly, SR> &equations,
+   const bool scc, const bool iteration_flag, const std::size_t iterations, const bool graphviz_output,
+   const std::size_t threads, std::true_type){
+  std::cout << "Solver: " << solver_title << std::endl;
+  return apply_solver<SolverType, Poly>(equations, scc, iteration_flag, iterations, graphviz_output, threads);
+}
+
+template <template <typename> class SolverType, typename SR, template <typename> class Poly>
+ValuationMap<SR> call_restricted_solver(const std::string solver_title, const GenericEquations<Poly, SR> &equations,
+   const bool scc, const bool iteration_flag, const std::size_t iterations, const bool graphviz_output,
+   const std::size_t threads, std::false_type){
+  std::cout << solver_title << " is not available for this semiring." << std::endl;
+  std::cout << "Solver: Newton Concrete (LDU)"<< std::endl;
+  return apply_solver<NewtonCLDU, Poly>(equations, scc, iteration_flag, iterations, graphviz_output, threads);
+}
+
 template <typename SR, template <typename> class Poly>
 ValuationMap<SR> call_solver(const std::string solver_name,  const GenericEquations<Poly, SR> &equations,
-   const bool scc, const bool iteration_flag, const std::size_t iterations, const bool graphviz_output){
+   const bool scc, const bool iteration_flag, const std::size_t iterations, const bool graphviz_output,
+   const std::size_t threads){
   if(0 == solver_name.compare("newtonSymb")) {
     std::cout << "Solver: Newton Symbolic" << std::endl;
-    return apply_solver<Newton, Poly>(equations, scc, iteration_flag, iterations, graphviz_output);
+    return apply_solver<Newton, Poly>(equations, scc, iteration_flag, iterations, graphviz_output, threads);
   }
   else if(0 == solver_name.compare("newtonConc")) {
     std::cout << "Solver: Newton Concrete"<< std::endl;
-    return apply_solver<NewtonCL, Poly>(equations, scc, iteration_flag, iterations, graphviz_output);
+    return apply_solver<NewtonCL, Poly>(equations, scc, iteration_flag, iterations, graphviz_output, threads);
   }
   else if(0 == solver_name.compare("newtonCLDU")) {
     std::cout << "Solver: Newton Concrete (LDU)"<< std::endl;
-    return apply_solver<NewtonCLDU, Poly>(equations, scc, iteration_flag, iterations, graphviz_output);
+    return apply_solver<NewtonCLDU, Poly>(equations, scc, iteration_flag, iterations, graphviz_output, threads);
   }
   else if(0 == solver_name.compare("newtonSLDU")) {
       std::cout << "Solver: Newton Symbolic (LDU)"<< std::endl;
-      return apply_solver<NewtonSLDU, Poly>(equations, scc, iteration_flag, iterations, graphviz_output);
+      return apply_solver<NewtonSLDU, Poly>(equations, scc, iteration_flag, iterations, graphviz_output, threads);
   }
   else if(0 == solver_name.compare("kleene")) {
     std::cout << "Solver: Kleene solver"<< std::endl;
-    return apply_solver<KleeneComm, Poly>(equations, scc, iteration_flag, iterations, graphviz_output);
+    return apply_solver<KleeneComm, Poly>(equations, scc, iteration_flag, iterations, graphviz_output, threads);
+  }
+  else if(0 == solver_name.compare("chaotic")) {
+    return call_restricted_solver<ChaoticIteration>("Chaotic iteration", equations, scc, iteration_flag, iterations, graphviz_output, threads,
+        std::is_same<Poly<SR>, CommutativePolynomial<SR> >());
+  }
+  else if(0 == solver_name.compare("knuth")) {
+    return call_restricted_solver<KnuthSolver>("Knuth", equations, scc, iteration_flag, iterations, graphviz_output, threads,
+        std::integral_constant<bool, SuperiorSemiring<SR>::value &&
+                                     std::is_same<Poly<SR>, CommutativePolynomial<SR> >::value>());
+  }
+  else if(0 == solver_name.compare("horn")) {
+    return call_restricted_solver<HornSolver>("Horn (worklist)", equations, scc, iteration_flag, iterations, graphviz_output, threads,
+        std::is_same<Poly<SR>, CommutativePolynomial<BoolSemiring> >());
   }
   else {
     // default-case
     std::cout << "Solver: Newton Concrete (LDU)"<< std::endl;
-    return apply_solver<NewtonCLDU, Poly>(equations, scc, iteration_flag, iterations, graphviz_output);
+    return apply_solver<NewtonCLDU, Poly>(equations, scc, iteration_flag, iterations, graphviz_output, threads);
   }
 }
 
@@ -105,8 +144,11 @@ int main(int argc, char* argv[]) {
     ( "free", "free semiring" )
     ( "lossy", "lossy semiring" )
     ( "prefix", po::value<int>(), "prefix semiring with given length")
+    ( "threads,t", po::value<int>(), "number of threads used to solve independent SCCs (with option --scc) and to evaluate the polynomials of one SCC in parallel. Default is 1." )
+    ( "ordering", po::value<std::string>(), "fill-reducing variable ordering used by the Newton solvers (\"none\", \"rcm\" (reverse Cuthill-McKee) or \"mindegree\" (minimum degree)). Default is none." )
+    ( "symbolic-cache", po::value<std::string>(), "directory in which the symbolic Newton solvers (newtonSymb, newtonSLDU) keep the star and the LDU decomposition of the Jacobian, so that later runs on systems of the same shape can reuse them. Default is no cache." )
     ( "graphviz", "create the file graph.dot with the equation graph (NOTE: currently only with option --scc) " )
-    ( "solver,s", po::value<std::string>(), "solver type (currently: \"newtonSymb\", \"newtonConc\", \"newtonCLDU\", \"newtonSLDU\", \"newtonNumeric\" (only for numeric semirings), or \"kleene\")" )
+    ( "solver,s", po::value<std::string>(), "solver type (currently: \"newtonSymb\", \"newtonConc\", \"newtonCLDU\", \"newtonSLDU\", \"newtonNumeric\" (only for numeric semirings), \"kleene\", \"chaotic\" (Gauss-Seidel style Kleene iteration), \"knuth\" (only for tropical, viterbi and maxmin), or \"horn\" (only for bool, the default there))" )
     ;
 
   po::variables_map vm;
@@ -216,6 +258,21 @@ int main(int argc, char* argv[]) {
   }
 
 
+  std::size_t threads = 1;
+  if (vm.count("threads") && vm["threads"].as<int>() > 1) {
+    threads = vm["threads"].as<int>();
+  }
+
+  if (vm.count("ordering") &&
+      !ParseVariableOrdering(vm["ordering"].as<std::string>(), DefaultVariableOrdering())) {
+    std::cerr << "Unknown variable ordering: " << vm["ordering"].as<std::string>() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (vm.count("symbolic-cache")) {
+    FreeSemiringCache::Directory() = vm["symbolic-cache"].as<std::string>();
+  }
+
   const auto iter_flag = vm.count("iterations");
   const auto graph_flag = vm.count("graphviz");
   const auto scc_flag = vm.count("scc");
@@ -232,7 +289,7 @@ int main(int argc, char* argv[]) {
     if (!vm.count("vec-simpl") && !vm.count("lin-simpl")) {
       DMSG("A");
       std::cout << result_string(
-          call_solver(solver_name, equations, scc_flag, iter_flag, iterations, graph_flag)
+          call_solver(solver_name, equations, scc_flag, iter_flag, iterations, graph_flag, threads)
           ) << std::endl;
 
     } else if (vm.count("vec-simpl") && !vm.count("lin-simpl")) {
@@ -241,7 +298,7 @@ int main(int argc, char* argv[]) {
         return SemilinearSetV{s};
       });
       std::cout << result_string(
-          call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag)
+          call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag, threads)
           ) << std::endl;
     } else {
       DMSG("C");
@@ -249,7 +306,7 @@ int main(int argc, char* argv[]) {
         return SemilinearSetL{s};
       });
       std::cout << result_string(
-          call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag)
+          call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag, threads)
           ) << std::endl;
     }
 #ifdef USE_GENEPI
@@ -258,7 +315,7 @@ int main(int argc, char* argv[]) {
       auto equations = p.slsetndd_parser(input_all);
       if (equations.empty()) return EXIT_FAILURE;
       std::cout << result_string(
-          call_solver(solver_name, equations, scc_flag, iter_flag, iterations, graph_flag)
+          call_solver(solver_name, equations, scc_flag, iter_flag, iterations, graph_flag, threads)
           ) << std::endl;
       SemilinSetNdd::solver_dealloc();
 #endif
@@ -276,14 +333,14 @@ int main(int argc, char* argv[]) {
         DummyDivider, SparseVecSimplifier>(equations);
       //PrintEquations(m_equations);
       std::cout << result_string(
-          call_solver(solver_name, equations, scc_flag, iter_flag, iterations, graph_flag)
+          call_solver(solver_name, equations, scc_flag, iter_flag, iterations, graph_flag, threads)
           ) << std::endl;
     } else {
       auto m_equations = SemilinearToPseudoLinearEquations<
         DummyDivider, DummyVecSimplifier>(equations);
       //PrintEquations(m_equations);
       std::cout << result_string(
-          call_solver(solver_name, equations, scc_flag, iter_flag, iterations, graph_flag)
+          call_solver(solver_name, equations, scc_flag, iter_flag, iterations, graph_flag, threads)
           ) << std::endl;
     }
 
@@ -297,7 +354,7 @@ int main(int argc, char* argv[]) {
 
     // apply solver to the equations
     std::cout << result_string(
-        call_solver(solver_name, equations, scc_flag, iter_flag, iterations, graph_flag)
+        call_solver(solver_name, equations, scc_flag, iter_flag, iterations, graph_flag, threads)
         ) << std::endl;
 
   } else if (vm.count("free")) {
@@ -308,7 +365,7 @@ int main(int argc, char* argv[]) {
   //if (equations2.empty()) return EXIT_FAILURE;
 
 //    std::cout << result_string(
-//        call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag)
+//        call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag, threads)
 //        ) << std::endl;
 #ifdef USE_LIBFA
   } else if (vm.count("lossy")) {
@@ -348,7 +405,7 @@ int main(int argc, char* argv[]) {
     //std::cout << result_string(result) << std::endl;
 
     //std::cout << result_string(
-    //    call_solver(solver_name, equations, scc_flag, iter_flag, iterations, graph_flag)
+    //    call_solver(solver_name, equations, scc_flag, iter_flag, iterations, graph_flag, threads)
     //    ) << std::endl;
 
   } else if (vm.count("float")) {
@@ -367,11 +424,11 @@ int main(int argc, char* argv[]) {
     if(0 == solver_name.compare("newtonNumeric")) {
       std::cout << "Solver: Newton Numeric (Float)"<< std::endl;
       std::cout << result_string(
-          apply_solver<NewtonNumeric>(equations2, scc_flag, iter_flag, iterations, graph_flag)
+          apply_solver<NewtonNumeric>(equations2, scc_flag, iter_flag, iterations, graph_flag, threads)
           ) << std::endl;
     } else  {
       std::cout << result_string(
-          call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag)
+          call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag, threads)
           ) << std::endl;
     }
 
@@ -387,8 +444,9 @@ int main(int argc, char* argv[]) {
 
     PrintEquations(equations);
     PrintEquations(equations2);
+      // boolean systems are solved in linear time by unit propagation
       std::cout << result_string(
-          call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag)
+          call_solver(vm.count("solver") ? solver_name : "horn", equations2, scc_flag, iter_flag, iterations, graph_flag, threads)
           ) << std::endl;
 
   } else if (vm.count("rat")) {
@@ -406,11 +464,11 @@ int main(int argc, char* argv[]) {
     if(0 == solver_name.compare("newtonNumeric")) {
       std::cout << "Solver: Newton Numeric (Rat)"<< std::endl;
       std::cout << result_string(
-          apply_solver<NewtonNumeric>(equations2, scc_flag, iter_flag, iterations, graph_flag)
+          apply_solver<NewtonNumeric>(equations2, scc_flag, iter_flag, iterations, graph_flag, threads)
           ) << std::endl;
     } else  {
       std::cout << result_string(
-          call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag)
+          call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag, threads)
           ) << std::endl;
     }
   }
@@ -424,7 +482,7 @@ int main(int argc, char* argv[]) {
       if (equations2.empty()) return EXIT_FAILURE;
 
         std::cout << result_string(
-            call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag)
+            call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag, threads)
             ) << std::endl;
 
     }
@@ -438,7 +496,7 @@ int main(int argc, char* argv[]) {
       if (equations2.empty()) return EXIT_FAILURE;
 
         std::cout << result_string(
-            call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag)
+            call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag, threads)
             ) << std::endl;
 
     }
@@ -452,7 +510,7 @@ int main(int argc, char* argv[]) {
           if (equations2.empty()) return EXIT_FAILURE;
 
             std::cout << result_string(
-                call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag)
+                call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag, threads)
                 ) << std::endl;
     }
     else if (vm.count("maxmin")) {
@@ -465,7 +523,7 @@ int main(int argc, char* argv[]) {
           if (equations2.empty()) return EXIT_FAILURE;
 
             std::cout << result_string(
-                call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag)
+                call_solver(solver_name, equations2, scc_flag, iter_flag, iterations, graph_flag, threads)
                 ) << std::endl;
 
     }
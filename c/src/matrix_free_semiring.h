@@ -2,26 +2,31 @@
 
 #include "semirings/free-semiring.h"
 #include "datastructs/matrix.h"
+#include "datastructs/sparse_matrix.h"
 
 
 template <typename SR>
 Matrix<SR> FreeSemiringMatrixEval(const Matrix<FreeSemiring> &matrix,
     const ValuationMap<SR> &valuation) {
 
-  const std::vector<FreeSemiring> &elements = matrix.getElements();
-  std::vector<SR> result;
+  /* We compile the DAG below all the elements of the original matrix at once.
+   * This way if different elements refer to the same FreeSemiring
+   * subexpression, it is evaluated only once. */
+  const CompiledDag dag = FreeSemiring::Compile(matrix.getElements());
+  DagEvaluator<SR> evaluator{dag};
 
-  /* We have a single Evaluator that is used for all evaluations of the elements
-   * of the original matrix.  This way if different elements refer to the same
-   * FreeSemiring subexpression, we memoize the result and reuse it. */
-  Evaluator<SR> evaluator{valuation};
+  return Matrix<SR>(matrix.getRows(), evaluator.Eval(valuation));
+}
+
+/* Same for sparse matrices, only the stored entries are evaluated. */
+template <typename SR>
+SparseMatrix<SR> FreeSemiringMatrixEval(const SparseMatrix<FreeSemiring> &matrix,
+    const ValuationMap<SR> &valuation) {
 
-  for(auto &elem : elements) {
-    //std::cout << "Matrix-Free-SR-eval -- Next entry" << std::endl;
-    result.emplace_back(elem.Eval(evaluator));
-  }
+  const CompiledDag dag = FreeSemiring::Compile(matrix.getValues());
+  DagEvaluator<SR> evaluator{dag};
 
-  return Matrix<SR>(matrix.getRows(), std::move(result));
+  return SparseMatrix<SR>(matrix.getPatternPtr(), evaluator.Eval(valuation));
 }
 
 /* FIXME: Temporary wrapper for compatibility with the old implementation. */
@@ -3,17 +3,20 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <initializer_list>
 #include <list>
 #include <map>
 #include <string>
 #include <unordered_map>
 #include <tuple>
+#include <vector>
 
 #include "../semirings/semiring.h"
 #include "../semirings/free-semiring.h"
 
 #include "../datastructs/matrix.h"
+#include "../datastructs/sparse_matrix.h"
 #include "../datastructs/var.h"
 #include "../datastructs/var_degree_map.h"
 
@@ -24,6 +27,9 @@
 
 template <typename SR> using MonomialMap = std::map<CommutativeMonomial, SR> ;
 
+template <typename SR>
+class CompiledPolynomialSystem;
+
 template <typename SR>
 class CommutativePolynomial : public Semiring<CommutativePolynomial<SR>,
                                    Commutativity::Commutative,
@@ -49,6 +55,9 @@ class CommutativePolynomial : public Semiring<CommutativePolynomial<SR>,
     template <typename SR2>
     friend class CommutativePolynomial;
 
+    template <typename SR2>
+    friend class CompiledPolynomialSystem;
+
     static void InsertMonomial(MonomialMap<SR> &map, const CommutativeMonomial &m,
         const SR &c) {
       if (c == SR::null()) {
@@ -321,6 +330,45 @@ class CommutativePolynomial : public Semiring<CommutativePolynomial<SR>,
     	return result;
     };
 
+    /* Same as jacobian but only the entries that are not structurally zero
+     * (i.e., the derivatives w.r.t. the variables that occur in the
+     * polynomial) are stored. */
+    static SparseMatrix< CommutativePolynomial<SR> > sparse_jacobian(
+        const std::vector< CommutativePolynomial<SR> > &polynomials,
+        const std::vector<VarId> &variables) {
+      std::unordered_map<VarId, std::size_t> varpos;
+      for (std::size_t j = 0; j < variables.size(); ++j) {
+        varpos[variables[j]] = j;
+      }
+
+      std::vector<std::size_t> row_begin{0};
+      std::vector<std::size_t> column_index;
+      std::vector< CommutativePolynomial<SR> > entries;
+      std::map<std::size_t, CommutativePolynomial<SR> > row;
+      for (const auto &polynomial : polynomials) {
+        row.clear();
+        for (const auto &monomial_coeff : polynomial.monomials_) {
+          for (const auto &v : monomial_coeff.first.variables_) {
+            auto lookup = varpos.find(v.first);
+            assert(lookup != varpos.end());
+            auto mult_mon = monomial_coeff.first.derivative(v.first);
+            row[lookup->second] += CommutativePolynomial(
+                monomial_coeff.second * mult_mon.first, std::move(mult_mon.second));
+          }
+        }
+        for (auto &column_entry : row) {
+          column_index.push_back(column_entry.first);
+          entries.push_back(std::move(column_entry.second));
+        }
+        row_begin.push_back(column_index.size());
+      }
+
+      auto pattern = std::make_shared<const SparsePattern>(
+          polynomials.size(), variables.size(),
+          std::move(row_begin), std::move(column_index));
+      return SparseMatrix< CommutativePolynomial<SR> >{pattern, std::move(entries)};
+    }
+
     SR eval(const ValuationMap<SR> &values) const {
       SR result = SR::null();
       for (const auto &monomial_coeff : monomials_) {
@@ -423,6 +471,56 @@ class CommutativePolynomial : public Semiring<CommutativePolynomial<SR>,
       return Matrix<FreeSemiring>{poly_matrix.getRows(), std::move(result)};
     }
 
+    /* Appends the structure of this polynomial to shape: its monomials in a
+     * canonical order, with every variable given by its index and every
+     * coefficient by its number in coefficients (0 stands for one(), the
+     * other values are numbered from 1 in the order in which they are first
+     * seen, and coefficients is extended accordingly).  So two polynomials
+     * get the same shape iff they are equal up to renaming the variables and
+     * the coefficients.  Returns false if some variable has no index. */
+    bool AppendShape(const std::unordered_map<VarId, std::uint32_t> &index,
+                     std::unordered_map<SR, std::uint32_t, SR> *coefficients,
+                     std::vector<std::uint32_t> *shape) const {
+      assert(coefficients && shape);
+
+      // the monomials as (index, degree) pairs sorted by index
+      std::vector< std::pair<std::vector<std::uint32_t>, const SR*> > monomials;
+      for (const auto &monomial_coeff : monomials_) {
+        std::vector< std::pair<std::uint32_t, std::uint32_t> > var_degrees;
+        for (const auto &var_degree : monomial_coeff.first) {
+          auto iter = index.find(var_degree.first);
+          if (iter == index.end()) {
+            return false;
+          }
+          var_degrees.emplace_back(iter->second, var_degree.second);
+        }
+        std::sort(var_degrees.begin(), var_degrees.end());
+        std::vector<std::uint32_t> signature;
+        for (const auto &var_degree : var_degrees) {
+          signature.push_back(var_degree.first);
+          signature.push_back(var_degree.second);
+        }
+        monomials.emplace_back(std::move(signature), &monomial_coeff.second);
+      }
+      std::sort(monomials.begin(), monomials.end(),
+                [](const std::pair<std::vector<std::uint32_t>, const SR*> &lhs,
+                   const std::pair<std::vector<std::uint32_t>, const SR*> &rhs) {
+                  return lhs.first < rhs.first;
+                });
+
+      shape->push_back(monomials.size());
+      for (const auto &monomial : monomials) {
+        std::uint32_t coefficient = 0;
+        if (!(*monomial.second == SR::one())) {
+          coefficient = coefficients->emplace(*monomial.second, coefficients->size() + 1).first->second;
+        }
+        shape->push_back(coefficient);
+        shape->push_back(monomial.first.size());
+        shape->insert(shape->end(), monomial.first.begin(), monomial.first.end());
+      }
+      return true;
+    }
+
     // FIXME: this is inefficient!
     Degree get_degree() const {
       Degree degree = 0;
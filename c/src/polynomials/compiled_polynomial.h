@@ -0,0 +1,386 @@
+/*
+ * compiled_polynomial.h
+ *
+ * A system of commutative polynomials compiled into flat arrays.
+ *
+ * The variables of the system are renumbered densely from 0 to n-1 so that
+ * valuations can be stored in a contiguous std::vector<SR> (instead of a
+ * ValuationMap) and every monomial is stored as a range of (index, degree)
+ * pairs.  This avoids hashing and pointer chasing when the same system is
+ * evaluated over and over again (which is what all our solvers do).
+ */
+
+#ifndef COMPILED_POLYNOMIAL_H_
+#define COMPILED_POLYNOMIAL_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/math/special_functions/binomial.hpp>
+
+#include "../datastructs/matrix.h"
+#include "../datastructs/sparse_matrix.h"
+#include "../datastructs/var.h"
+#include "../datastructs/var_degree_map.h"
+
+#include "../semirings/semiring.h"
+
+#include "../utils/thread_pool.h"
+
+#include "commutative_polynomial.h"
+
+template <typename SR>
+class CompiledPolynomialSystem {
+  public:
+    /* Compile the given polynomials.  The variable variables[i] gets the index
+     * i, i.e., its value is expected at position i of the valuation vectors.
+     * All the variables of the polynomials must be in variables. */
+    CompiledPolynomialSystem(const std::vector< CommutativePolynomial<SR> > &polynomials,
+                             const std::vector<VarId> &variables)
+        : num_variables_(variables.size()) {
+      std::unordered_map<VarId, std::size_t> index;
+      index.reserve(variables.size());
+      for (std::size_t i = 0; i < variables.size(); ++i) {
+        index.insert(std::make_pair(variables[i], i));
+      }
+
+      poly_begin_.reserve(polynomials.size() + 1);
+      degrees_.reserve(polynomials.size());
+      monomial_begin_.push_back(0);
+      for (const auto &polynomial : polynomials) {
+        poly_begin_.push_back(coefficients_.size());
+        Degree poly_degree = 0;
+        for (const auto &monomial_coeff : polynomial.monomials_) {
+          Degree monomial_degree = 0;
+          for (const auto &var_degree : monomial_coeff.first) {
+            auto lookup = index.find(var_degree.first);
+            assert(lookup != index.end());
+            factors_.push_back(Factor{lookup->second, var_degree.second,
+                                      binomials_.size()});
+            /* binomials_[binomial_begin + j] = (degree choose j) */
+            for (Degree j = 0; j <= var_degree.second; ++j) {
+              binomials_.push_back(Binomial(var_degree.second, j));
+            }
+            monomial_degree += var_degree.second;
+          }
+          coefficients_.push_back(monomial_coeff.second);
+          monomial_begin_.push_back(factors_.size());
+          poly_degree = std::max(poly_degree, monomial_degree);
+        }
+        degrees_.push_back(poly_degree);
+      }
+      poly_begin_.push_back(coefficients_.size());
+    }
+
+    std::size_t size() const { return degrees_.size(); }
+
+    std::size_t GetNumVariables() const { return num_variables_; }
+
+    Degree GetDegree(std::size_t i) const { return degrees_[i]; }
+
+    /* Evaluate the i-th polynomial. */
+    SR eval(std::size_t i, const std::vector<SR> &values) const {
+      assert(values.size() >= num_variables_);
+      SR result = SR::null();
+      for (std::size_t m = poly_begin_[i]; m < poly_begin_[i + 1]; ++m) {
+        result += EvalMonomial(m, values);
+      }
+      return result;
+    }
+
+    /* Monomial m (including its coefficient), where the monomials of the i-th
+     * polynomial are MonomialBegin(i) to MonomialEnd(i)-1. */
+    SR EvalMonomial(std::size_t m, const std::vector<SR> &values) const {
+      SR monomial_value = SR::one();
+      for (std::size_t f = monomial_begin_[m]; f < monomial_begin_[m + 1]; ++f) {
+        // exponentiation is more efficient than iterated multiplication (binary exp.)
+        monomial_value *= pow(values[factors_[f].index], factors_[f].degree);
+      }
+      return coefficients_[m] * monomial_value;
+    }
+
+    std::size_t MonomialBegin(std::size_t i) const { return poly_begin_[i]; }
+    std::size_t MonomialEnd(std::size_t i) const { return poly_begin_[i + 1]; }
+    std::size_t GetNumMonomials() const { return coefficients_.size(); }
+
+    const SR& GetCoefficient(std::size_t m) const { return coefficients_[m]; }
+
+    /* The variables of monomial m are GetFactorIndex(f) for f from
+     * FactorBegin(m) to FactorEnd(m)-1 (every variable occurs only once). */
+    std::size_t FactorBegin(std::size_t m) const { return monomial_begin_[m]; }
+    std::size_t FactorEnd(std::size_t m) const { return monomial_begin_[m + 1]; }
+    std::size_t GetFactorIndex(std::size_t f) const { return factors_[f].index; }
+
+    /* The monomials every variable occurs in (in CSR form): the monomials of
+     * variable j are occurrences[begin[j]] to occurrences[begin[j+1]-1]. */
+    void MonomialOccurrences(std::vector<std::size_t> &begin,
+                             std::vector<std::size_t> &occurrences) const {
+      begin.assign(num_variables_ + 1, 0);
+      for (const auto &factor : factors_) {
+        ++begin[factor.index + 1];
+      }
+      for (std::size_t j = 0; j < num_variables_; ++j) {
+        begin[j + 1] += begin[j];
+      }
+      occurrences.resize(factors_.size());
+      std::vector<std::size_t> next(begin.begin(), begin.end() - 1);
+      for (std::size_t m = 0; m < coefficients_.size(); ++m) {
+        for (std::size_t f = monomial_begin_[m]; f < monomial_begin_[m + 1]; ++f) {
+          occurrences[next[factors_[f].index]++] = m;
+        }
+      }
+    }
+
+    /* For every variable the polynomials it occurs in (sorted, without
+     * duplicates), i.e., the ones that have to be evaluated again when its
+     * value changes. */
+    std::vector< std::vector<std::size_t> > Dependents() const {
+      std::vector<std::size_t> owner(coefficients_.size());
+      for (std::size_t i = 0; i < size(); ++i) {
+        std::fill(owner.begin() + poly_begin_[i], owner.begin() + poly_begin_[i + 1], i);
+      }
+      std::vector<std::size_t> begin;
+      std::vector<std::size_t> occurrences;
+      MonomialOccurrences(begin, occurrences);
+      std::vector< std::vector<std::size_t> > dependents(num_variables_);
+      for (std::size_t j = 0; j < num_variables_; ++j) {
+        for (std::size_t o = begin[j]; o < begin[j + 1]; ++o) {
+          // the occurrences of a variable are sorted by monomial, so the
+          // owners are sorted as well
+          if (dependents[j].empty() || dependents[j].back() != owner[occurrences[o]]) {
+            dependents[j].push_back(owner[occurrences[o]]);
+          }
+        }
+      }
+      return dependents;
+    }
+
+    /*
+     * Evaluate the height unfolding of the i-th polynomial (see
+     * CommutativeMonomial::HeightUnfolding) at X^{<h} = previous, X^{<h+1} =
+     * current and X^{=h} = update without constructing it: the unfolding of
+     * c X_1^{d_1} ... X_m^{d_m} is
+     *   c sum_k L_k (sum_{t<d_k} (X_k^{<h+1})^t X_k^{=h} (X_k^{<h})^{d_k-1-t}) R_k
+     * with the prefix products L_k = prod_{j<k} (X_j^{<h+1})^{d_j} and the
+     * suffix products R_k = prod_{j>k} (X_j^{<h})^{d_j}.  The terms with a
+     * zero update are skipped.
+     */
+    SR EvalHeightUnfolding(std::size_t i, const std::vector<SR> &previous,
+                           const std::vector<SR> &current,
+                           const std::vector<SR> &update) const {
+      SR result = SR::null();
+      std::vector<SR> suffix;
+      for (std::size_t m = poly_begin_[i]; m < poly_begin_[i + 1]; ++m) {
+        const std::size_t first = monomial_begin_[m];
+        const std::size_t last = monomial_begin_[m + 1];
+
+        // suffix[k] = R_{first+k}
+        suffix.assign(last - first, SR::one());
+        for (std::size_t k = last - first; k > 1; --k) {
+          const Factor &factor = factors_[first + k - 1];
+          suffix[k - 2] = suffix[k - 1] * pow(previous[factor.index], factor.degree);
+        }
+
+        SR prefix = SR::one();
+        SR monomial_value = SR::null();
+        for (std::size_t f = first; f < last; ++f) {
+          const Factor &factor = factors_[f];
+          const SR &u = update[factor.index];
+          if (!(u == SR::null())) {
+            SR center = u;
+            if (factor.degree > 1) {
+              center = SR::null();
+              for (Degree t = 0; t < factor.degree; ++t) {
+                center += pow(current[factor.index], t) * u *
+                          pow(previous[factor.index], factor.degree - 1 - t);
+              }
+            }
+            monomial_value += prefix * center * suffix[f - first];
+          }
+          prefix *= pow(current[factor.index], factor.degree);
+        }
+        result += coefficients_[m] * monomial_value;
+      }
+      return result;
+    }
+
+    /* Evaluate all polynomials (in parallel on the solver thread pool if
+     * there is one). */
+    std::vector<SR> eval(const std::vector<SR> &values) const {
+      std::vector<SR> result(size(), SR::null());
+      ParallelFor(GetThreadPool(), size(), kMinParallelBlock,
+                  [&](std::size_t i) { result[i] = eval(i, values); });
+      return result;
+    }
+
+    /* Evaluate all polynomials at the given column vector. */
+    Matrix<SR> eval(const Matrix<SR> &values) const {
+      assert(values.getColumns() == 1);
+      return Matrix<SR>{size(), eval(values.getElements())};
+    }
+
+    /* Same as CommutativePolynomial::AllNewtonDerivatives for the i-th
+     * polynomial, i.e., the sum over all derivatives of order at least 2 of
+     * the polynomial at previous_newton applied to newton_update. */
+    SR AllNewtonDerivatives(std::size_t i,
+                            const std::vector<SR> &previous_newton,
+                            const std::vector<SR> &newton_update) const {
+      SR result = SR::null();
+      std::vector<Degree> deriv;
+
+      for (std::size_t m = poly_begin_[i]; m < poly_begin_[i + 1]; ++m) {
+        const std::size_t first = monomial_begin_[m];
+        const std::size_t last = monomial_begin_[m + 1];
+
+        Degree monomial_degree = 0;
+        for (std::size_t f = first; f < last; ++f) {
+          monomial_degree += factors_[f].degree;
+        }
+        if (monomial_degree < 2) {
+          /* We look at only 2nd derivatives and in this case the value of the
+           * monomial will be zero. */
+          continue;
+        }
+
+        /* Enumerate all combinations of derivative degrees (one for every
+         * variable of the monomial) whose sum is at least 2. */
+        deriv.assign(last - first, 0);
+        Degree deriv_sum = 0;
+        while (NextCombination(first, deriv, deriv_sum)) {
+          if (deriv_sum < 2) {
+            continue;
+          }
+
+          SR monomial_value = coefficients_[m];
+          SR prod = SR::one();
+          for (std::size_t f = first; f < last; ++f) {
+            const Factor &factor = factors_[f];
+            const Degree deriv_degree = deriv[f - first];
+            if (deriv_degree > 0) {
+              monomial_value *= binomials_[factor.binomial_begin + deriv_degree];
+              for (Degree c = 0; c < deriv_degree; ++c) {
+                prod *= newton_update[factor.index];
+              }
+            }
+            // the variables "having survived" the derivative get assigned the
+            // previous newton values
+            for (Degree c = deriv_degree; c < factor.degree; ++c) {
+              monomial_value *= previous_newton[factor.index];
+            }
+          }
+          result += monomial_value * prod;
+        }
+      }
+      return result;
+    }
+
+    /* The pool for data parallel loops over the polynomials, only semirings
+     * whose operations may be used concurrently get one. */
+    static ThreadPool* GetThreadPool() {
+      return IsThreadSafe<SR>::value ? SolverThreadPool() : nullptr;
+    }
+
+    /* Below this number of polynomials a loop is not split. */
+    static constexpr std::size_t kMinParallelBlock = 32;
+
+  private:
+    struct Factor {
+      std::size_t index;
+      Degree degree;
+      std::size_t binomial_begin;
+    };
+
+    static Degree Binomial(Degree n, Degree k) {
+      auto binomial_coeff_d = boost::math::binomial_coefficient<double>(n, k);
+      /* Check if we don't overflow. */
+      assert(static_cast<std::uint_fast64_t>(binomial_coeff_d) <=
+             static_cast<std::uint_fast64_t>(
+                  std::numeric_limits<Degree>::max()));
+      return static_cast<Degree>(binomial_coeff_d);
+    }
+
+    /* Advance deriv (the derivative degrees of the factors of a monomial
+     * starting at first) to the next combination.  Returns false after the
+     * last one. */
+    bool NextCombination(std::size_t first, std::vector<Degree> &deriv,
+                         Degree &deriv_sum) const {
+      for (std::size_t k = 0; k < deriv.size(); ++k) {
+        if (deriv[k] < factors_[first + k].degree) {
+          ++deriv[k];
+          ++deriv_sum;
+          return true;
+        }
+        deriv_sum -= deriv[k];
+        deriv[k] = 0;
+      }
+      return false;
+    }
+
+    std::size_t num_variables_;
+
+    /* Polynomial i consists of the monomials poly_begin_[i] to
+     * poly_begin_[i+1]-1, monomial m has the coefficient coefficients_[m] and
+     * the factors monomial_begin_[m] to monomial_begin_[m+1]-1. */
+    std::vector<std::size_t> poly_begin_;
+    std::vector<std::size_t> monomial_begin_;
+    std::vector<SR> coefficients_;
+    std::vector<Factor> factors_;
+    std::vector<Degree> binomials_;
+    std::vector<Degree> degrees_;
+};
+
+
+/*
+ * The Jacobian of a polynomial system in sparse (CSR) form.  Only the entries
+ * that are not structurally zero are compiled and evaluated, the structure of
+ * the LDU factors (including the fill-in) is computed once up front so that
+ * every evaluation can be factorized without any further symbolic work.
+ */
+template <typename SR>
+class CompiledSparseJacobian {
+  public:
+    CompiledSparseJacobian(const std::vector< CommutativePolynomial<SR> > &polynomials,
+                           const std::vector<VarId> &variables)
+        : CompiledSparseJacobian(
+            CommutativePolynomial<SR>::sparse_jacobian(polynomials, variables),
+            variables) {}
+
+    std::size_t GetNumVariables() const { return entries_.GetNumVariables(); }
+
+    const std::shared_ptr<const SparsePattern>& GetPattern() const {
+      return pattern_;
+    }
+
+    const std::shared_ptr<const SparsePattern>& GetLDUPattern() const {
+      return ldu_pattern_;
+    }
+
+    /* Evaluate the nonzero entries of the Jacobian. */
+    SparseMatrix<SR> eval(const std::vector<SR> &values) const {
+      return SparseMatrix<SR>{pattern_, entries_.eval(values)};
+    }
+
+    /* Solve x = J(values) x + rhs using the sparse LDU decomposition. */
+    Matrix<SR> solve_LDU(const std::vector<SR> &values, const Matrix<SR> &rhs) const {
+      return SparseMatrix<SR>::subst_LDU(
+          SparseMatrix<SR>::LDU_decomposition(eval(values), ldu_pattern_), rhs);
+    }
+
+  private:
+    CompiledSparseJacobian(const SparseMatrix< CommutativePolynomial<SR> > &jacobian,
+                           const std::vector<VarId> &variables)
+        : pattern_(jacobian.getPatternPtr()),
+          ldu_pattern_(jacobian.getPattern().LDU_pattern()),
+          entries_(jacobian.getValues(), variables) {}
+
+    std::shared_ptr<const SparsePattern> pattern_;
+    std::shared_ptr<const SparsePattern> ldu_pattern_;
+    CompiledPolynomialSystem<SR> entries_;
+};
+
+#endif /* COMPILED_POLYNOMIAL_H_ */
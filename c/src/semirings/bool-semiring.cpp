@@ -56,18 +56,16 @@ BoolSemiring BoolSemiring::star() const
   return BoolSemiring(true);
 }
 
+/* The elements are trivial to construct, so we do not cache them in shared
+ * pointers (the lazy initialization of those was not thread-safe). */
 BoolSemiring BoolSemiring::null()
 {
-  if(!BoolSemiring::elem_null)
-    BoolSemiring::elem_null = std::shared_ptr<BoolSemiring>(new BoolSemiring());
-  return *BoolSemiring::elem_null;
+  return BoolSemiring(false);
 }
 
 BoolSemiring BoolSemiring::one()
 {
-  if(!BoolSemiring::elem_one)
-    BoolSemiring::elem_one = std::shared_ptr<BoolSemiring>(new BoolSemiring(true));
-  return *BoolSemiring::elem_one;
+  return BoolSemiring(true);
 }
 
 std::string BoolSemiring::string() const
@@ -76,6 +74,3 @@ std::string BoolSemiring::string() const
   ss << this->val;
   return ss.str();
 }
-
-std::shared_ptr<BoolSemiring> BoolSemiring::elem_null;
-std::shared_ptr<BoolSemiring> BoolSemiring::elem_one;
@@ -1,8 +1,12 @@
 #ifndef BOOL_SEMIRING_H
 #define BOOL_SEMIRING_H
 
+#include <cassert>
 #include <string>
-#include <memory>
+#include <vector>
+
+#include "../datastructs/bit_matrix.h"
+#include "../datastructs/matrix_kernels.h"
 
 #include "semiring.h"
 
@@ -10,8 +14,6 @@ class BoolSemiring : public StarableSemiring<BoolSemiring, Commutativity::Commut
 {
 private:
 	bool val;
-	static std::shared_ptr<BoolSemiring> elem_null;
-	static std::shared_ptr<BoolSemiring> elem_one;
 public:
 	BoolSemiring();
 	BoolSemiring(bool val);
@@ -24,8 +26,78 @@ public:
 	static BoolSemiring null();
 	static BoolSemiring one();
 	std::string string() const;
+	bool getValue() const { return val; }
 	static bool is_idempotent;
 	static bool is_commutative;
 };
 
+template <>
+struct IsThreadSafe<BoolSemiring> {
+  static constexpr bool value = true;
+};
+
+/* Stored as bytes, std::vector<bool> does not give us a plain array.  Only
+ * the addition works on them, see ScalarMatrixKernels<BoolSemiring> below for
+ * the rest. */
+template <>
+struct ScalarSemiring<BoolSemiring> {
+  static constexpr bool value = true;
+  typedef unsigned char Scalar;
+
+  static Scalar Get(const BoolSemiring &elem) { return elem.getValue(); }
+  static BoolSemiring Make(Scalar value) { return BoolSemiring(value != 0); }
+
+  static Scalar Add(Scalar a, Scalar b) { return a | b; }
+  static Scalar Mul(Scalar a, Scalar b) { return a & b; }
+};
+
+
+/*
+ * Boolean matrices are packed into bitsets (64 entries per word) instead of
+ * arrays of bytes, see BitMatrix.
+ */
+template <>
+class ScalarMatrixKernels<BoolSemiring> {
+  public:
+    static std::vector<BoolSemiring> Multiply(const std::vector<BoolSemiring> &A,
+                                              const std::vector<BoolSemiring> &B,
+                                              std::size_t rows, std::size_t inner,
+                                              std::size_t columns) {
+      return Unpack(Pack(A, rows, inner).Multiply(Pack(B, inner, columns),
+                                                  SolverThreadPool()));
+    }
+
+    static std::vector<BoolSemiring> Star(const std::vector<BoolSemiring> &A,
+                                          std::size_t n) {
+      BitMatrix bits = Pack(A, n, n);
+      bits.Closure(SolverThreadPool());
+      return Unpack(bits);
+    }
+
+    static BitMatrix Pack(const std::vector<BoolSemiring> &elements,
+                          std::size_t rows, std::size_t columns) {
+      assert(elements.size() == rows * columns);
+      BitMatrix result{rows, columns};
+      for (std::size_t r = 0; r < rows; ++r) {
+        for (std::size_t c = 0; c < columns; ++c) {
+          if (elements[r * columns + c].getValue()) {
+            result.Set(r, c);
+          }
+        }
+      }
+      return result;
+    }
+
+    static std::vector<BoolSemiring> Unpack(const BitMatrix &bits) {
+      std::vector<BoolSemiring> result;
+      result.reserve(bits.getRows() * bits.getColumns());
+      for (std::size_t r = 0; r < bits.getRows(); ++r) {
+        for (std::size_t c = 0; c < bits.getColumns(); ++c) {
+          result.emplace_back(bits.Get(r, c));
+        }
+      }
+      return result;
+    }
+};
+
 #endif
@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstddef>
 #include <limits>
 #include <sstream>
 #include <string>
@@ -10,6 +11,10 @@
 #include "semiring.h"
 #include "../utils/profiling-macros.h"
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #define INFTY_FLOAT (std::numeric_limits<double>::max())
 
 class FloatSemiring : public StarableSemiring<FloatSemiring,
@@ -117,4 +122,54 @@ class FloatSemiring : public StarableSemiring<FloatSemiring,
 
 };
 
+template <>
+struct IsThreadSafe<FloatSemiring> {
+  static constexpr bool value = true;
+};
+
+template <>
+struct ScalarSemiring<FloatSemiring> {
+  static constexpr bool value = true;
+  typedef double Scalar;
+
+  static Scalar Get(const FloatSemiring &elem) { return elem.getValue(); }
+  static FloatSemiring Make(Scalar value) { return FloatSemiring(value); }
+
+  static Scalar Add(Scalar a, Scalar b) {
+    return (a == INFTY_FLOAT || b == INFTY_FLOAT) ? INFTY_FLOAT : a + b;
+  }
+
+  static Scalar Mul(Scalar a, Scalar b) {
+    return (a == INFTY_FLOAT || b == INFTY_FLOAT) ? INFTY_FLOAT : a * b;
+  }
+
+  static Scalar Star(Scalar a) {
+    return (a >= 1 || a == INFTY_FLOAT) ? INFTY_FLOAT : 1 / (1 - a);
+  }
+
+  static void AddScaledRow(Scalar *row, Scalar a, const Scalar *other, std::size_t n) {
+    std::size_t c = 0;
+#ifdef __AVX2__
+    const __m256d inf = _mm256_set1_pd(INFTY_FLOAT);
+    const __m256d factor = _mm256_set1_pd(a);
+    const __m256d factor_inf = _mm256_set1_pd(a == INFTY_FLOAT ? -1.0 : 0.0);
+    for (; c + 4 <= n; c += 4) {
+      const __m256d o = _mm256_loadu_pd(other + c);
+      const __m256d r = _mm256_loadu_pd(row + c);
+      const __m256d product = _mm256_mul_pd(factor, o);
+      // the result is infinite if any of the operands (or the product) is
+      __m256d is_inf = _mm256_or_pd(_mm256_cmp_pd(o, inf, _CMP_EQ_OQ),
+                                    _mm256_cmp_pd(r, inf, _CMP_EQ_OQ));
+      is_inf = _mm256_or_pd(is_inf, _mm256_cmp_pd(product, inf, _CMP_EQ_OQ));
+      is_inf = _mm256_or_pd(is_inf, factor_inf);
+      const __m256d sum = _mm256_add_pd(r, product);
+      _mm256_storeu_pd(row + c, _mm256_blendv_pd(sum, inf, is_inf));
+    }
+#endif
+    for (; c < n; ++c) {
+      row[c] = Add(row[c], Mul(a, other[c]));
+    }
+  }
+};
+
 #endif
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+#include "../datastructs/hash.h"
+
+#include "free-semiring-cache.h"
+
+std::string FreeSemiringCache::FileName(const std::string &kind,
+                                        const std::vector<std::uint32_t> &key,
+                                        SemiringLaws laws) {
+  std::stringstream ss;
+  ss << Directory() << "/" << kind << "-" << EncodeLaws(laws) << "-"
+     << std::hex << std::setw(16) << std::setfill('0')
+     << std::hash< std::vector<std::uint32_t> >()(key) << ".fpc";
+  return ss.str();
+}
+
+bool FreeSemiringCache::Load(const std::string &kind, const std::vector<std::uint32_t> &key,
+                             SemiringLaws laws, const std::vector<VarId> &leaves,
+                             std::vector<FreeSemiring> *elements) {
+  assert(elements);
+  std::ifstream file{FileName(kind, key, laws), std::ios::binary};
+  if (!file) {
+    return false;
+  }
+  file.seekg(0, std::ios::end);
+  const std::streamoff size = file.tellg();
+  if (size < static_cast<std::streamoff>(sizeof(Header)) || size % sizeof(std::uint32_t) != 0) {
+    return false;
+  }
+  std::vector<std::uint32_t> words(size / sizeof(std::uint32_t));
+  file.seekg(0, std::ios::beg);
+  if (!file.read(reinterpret_cast<char*>(words.data()), size)) {
+    return false;
+  }
+
+  Header header;
+  std::copy(words.begin(), words.begin() + sizeof(Header) / sizeof(std::uint32_t),
+            reinterpret_cast<std::uint32_t*>(&header));
+  const std::size_t expected_size = sizeof(Header) / sizeof(std::uint32_t) +
+    std::size_t{header.key_size} + 3 * std::size_t{header.num_operations} + header.num_roots;
+  if (header.magic != kMagic() || header.version != kVersion() ||
+      header.laws != EncodeLaws(laws) || header.num_leaves != leaves.size() ||
+      words.size() != expected_size) {
+    return false;
+  }
+
+  auto iter = words.begin() + sizeof(Header) / sizeof(std::uint32_t);
+  // a different key with the same hash
+  if (header.key_size != key.size() || !std::equal(key.begin(), key.end(), iter)) {
+    return false;
+  }
+  iter += header.key_size;
+
+  std::vector<FreeSemiring> values;
+  values.reserve(header.num_operations);
+  for (std::size_t i = 0; i < header.num_operations; ++i, iter += 3) {
+    const auto op = static_cast<CompiledDag::Op>(iter[0]);
+    const std::uint32_t lhs = iter[1];
+    const std::uint32_t rhs = iter[2];
+    // every operation only refers to the ones before it
+    const bool binary = op == CompiledDag::Op::Addition || op == CompiledDag::Op::Multiplication;
+    if ((binary || op == CompiledDag::Op::Star) && (lhs >= i || (binary && rhs >= i))) {
+      return false;
+    }
+    switch (op) {
+      case CompiledDag::Op::Addition:
+        values.push_back(values[lhs] + values[rhs]);
+        break;
+      case CompiledDag::Op::Multiplication:
+        values.push_back(values[lhs] * values[rhs]);
+        break;
+      case CompiledDag::Op::Star:
+        values.push_back(values[lhs].star());
+        break;
+      case CompiledDag::Op::Element:
+        if (lhs >= leaves.size()) {
+          return false;
+        }
+        values.push_back(FreeSemiring{leaves[lhs]});
+        break;
+      case CompiledDag::Op::Epsilon:
+        values.push_back(FreeSemiring::one());
+        break;
+      case CompiledDag::Op::Empty:
+        values.push_back(FreeSemiring::null());
+        break;
+      default:
+        return false;
+    }
+  }
+
+  std::vector<FreeSemiring> result;
+  result.reserve(header.num_roots);
+  for (std::size_t i = 0; i < header.num_roots; ++i, ++iter) {
+    if (*iter >= values.size()) {
+      return false;
+    }
+    result.push_back(values[*iter]);
+  }
+  *elements = std::move(result);
+  return true;
+}
+
+bool FreeSemiringCache::Store(const std::string &kind, const std::vector<std::uint32_t> &key,
+                              SemiringLaws laws, const std::vector<VarId> &leaves,
+                              const std::vector<FreeSemiring> &elements) {
+  std::unordered_map<VarId, std::uint32_t> leaf_index;
+  for (std::size_t i = 0; i < leaves.size(); ++i) {
+    leaf_index.emplace(leaves[i], i);
+  }
+
+  const CompiledDag dag = FreeSemiring::Compile(elements);
+  std::vector<std::uint32_t> operations;
+  operations.reserve(3 * dag.size());
+  for (std::size_t i = 0; i < dag.size(); ++i) {
+    std::uint32_t lhs = dag[i].lhs;
+    std::uint32_t rhs = dag[i].rhs;
+    if (dag[i].op == CompiledDag::Op::Element) {
+      auto iter = leaf_index.find(dag[i].var);
+      if (iter == leaf_index.end()) {
+        return false;
+      }
+      lhs = iter->second;
+      rhs = 0;
+    }
+    operations.push_back(static_cast<std::uint32_t>(dag[i].op));
+    operations.push_back(lhs);
+    operations.push_back(rhs);
+  }
+  std::vector<std::uint32_t> roots(dag.GetRoots().begin(), dag.GetRoots().end());
+
+  Header header;
+  header.magic = kMagic();
+  header.version = kVersion();
+  header.laws = EncodeLaws(laws);
+  header.key_size = key.size();
+  header.num_leaves = leaves.size();
+  header.num_operations = dag.size();
+  header.num_roots = roots.size();
+  header.reserved = 0;
+
+  // written to a temporary file first, so that concurrent runs never see a
+  // partial entry
+  const std::string file_name = FileName(kind, key, laws);
+  std::stringstream tmp_name;
+  tmp_name << file_name << ".tmp" << std::random_device()();
+  {
+    std::ofstream file{tmp_name.str(), std::ios::binary};
+    auto write = [&file](const std::vector<std::uint32_t> &words) {
+      file.write(reinterpret_cast<const char*>(words.data()),
+                 words.size() * sizeof(std::uint32_t));
+    };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    write(key);
+    write(operations);
+    write(roots);
+    // closing flushes the last part, which may fail as well
+    file.close();
+    if (!file) {
+      std::cerr << "Cannot write the cache file " << tmp_name.str() << std::endl;
+      std::remove(tmp_name.str().c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmp_name.str().c_str(), file_name.c_str()) != 0) {
+    std::remove(tmp_name.str().c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../datastructs/var.h"
+
+#include "free-semiring.h"
+
+/*
+ * FreeSemiringCache
+ *
+ * Keeps FreeSemiring elements that are expensive to compute (e.g., the star or
+ * the LDU decomposition of the symbolic Jacobian) in files, so that later runs
+ * can load them instead of computing them again.  An entry is stored under a
+ * kind and a key that describes what it was computed from.  The hash of the
+ * key only names the file, the key itself is stored as well and compared in
+ * full when loading.  The variables of the elements are stored as indices
+ * into a list of leaves given by the caller (e.g., the variables of the system
+ * followed by the fresh variables standing for the coefficients), so an entry
+ * can be loaded by a process where the variables have different ids.
+ *
+ * A file holds the CompiledDag of the elements in fixed size records of 32-bit
+ * words (in the byte order of the machine), so it can also be mapped into
+ * memory as it is:
+ *
+ *   Header      magic, version, laws, the number of leaves and the sizes of the
+ *               following arrays
+ *   key         key_size words
+ *   operations  num_operations records of 3 words {op, lhs, rhs}, where lhs
+ *               is the index of the leaf for an Element
+ *   roots       num_roots words
+ *
+ * Entries are only used with the same SemiringLaws they were built with (see
+ * FreeSemiring::AssumeLaws).
+ */
+class FreeSemiringCache {
+  public:
+    /* The directory of the cache files, empty (the default) turns the cache
+     * off.  It is only set before solving, e.g., from the command line. */
+    static std::string& Directory() {
+      static std::string directory;
+      return directory;
+    }
+
+    static bool Enabled() { return !Directory().empty(); }
+
+    /* If there is an entry for kind, key and laws, replaces elements with it
+     * and returns true. */
+    static bool Load(const std::string &kind, const std::vector<std::uint32_t> &key,
+                     SemiringLaws laws, const std::vector<VarId> &leaves,
+                     std::vector<FreeSemiring> *elements);
+
+    /* Stores the elements, returns false if that failed (or if they contain
+     * a variable that is not one of the leaves). */
+    static bool Store(const std::string &kind, const std::vector<std::uint32_t> &key,
+                      SemiringLaws laws, const std::vector<VarId> &leaves,
+                      const std::vector<FreeSemiring> &elements);
+
+  private:
+    struct Header {
+      std::uint32_t magic;
+      std::uint32_t version;
+      std::uint32_t laws;
+      std::uint32_t key_size;
+      std::uint32_t num_leaves;
+      std::uint32_t num_operations;
+      std::uint32_t num_roots;
+      std::uint32_t reserved;
+    };
+
+    static std::uint32_t kMagic() { return 0x43505346; }  // "FSPC"
+    static std::uint32_t kVersion() { return 1; }
+
+    static std::uint32_t EncodeLaws(SemiringLaws laws) {
+      return (laws.commutative ? 1 : 0) | (laws.idempotent ? 2 : 0);
+    }
+
+    static std::string FileName(const std::string &kind,
+                                const std::vector<std::uint32_t> &key,
+                                SemiringLaws laws);
+};
@@ -1,3 +1,13 @@
 #include "free-semiring.h"
 
 NodeFactory FreeSemiring::factory_;
+thread_local SemiringLaws FreeSemiring::laws_;
+
+CompiledDag FreeSemiring::Compile(const std::vector<FreeSemiring> &elements) {
+  std::vector<NodePtr> roots;
+  roots.reserve(elements.size());
+  for (const auto &elem : elements) {
+    roots.push_back(elem.node_);
+  }
+  return CompiledDag{roots};
+}
@@ -1,13 +1,19 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "../datastructs/hash.h"
 #include "../datastructs/var.h"
 #include "../datastructs/free-structure.h"
 
 #include "../utils/profiling-macros.h"
+#include "../utils/thread_pool.h"
 
 #include "semiring.h"
 
@@ -18,7 +24,7 @@ class FreeSemiring : public StarableSemiring<FreeSemiring, Commutativity::NonCom
   public:
     /* Default constructor creates zero element. */
     FreeSemiring() {
-      node_ = factory_.GetEmpty();
+      node_ = NodeFactory::Acquire(factory_.GetEmpty());
     }
 
     FreeSemiring(const VarId var) {
@@ -26,38 +32,66 @@ class FreeSemiring : public StarableSemiring<FreeSemiring, Commutativity::NonCom
       //std::cout << Var::GetVar(var).string() << std::endl;
     }
 
+    /* Every FreeSemiring holds a reference to its node, see
+     * [Note: Garbage].  Moving takes over the reference without touching the
+     * node, the moved-from element may only be assigned to or destroyed. */
+    FreeSemiring(const FreeSemiring &x) : node_(NodeFactory::Acquire(x.node_)) {}
+
+    FreeSemiring(FreeSemiring &&x) : node_(x.node_) {
+      x.node_ = nullptr;
+    }
+
+    ~FreeSemiring() {
+      if (node_ != nullptr) {
+        NodeFactory::Release(node_);
+      }
+    }
+
+    FreeSemiring& operator=(const FreeSemiring &x) {
+      SetNode(NodeFactory::Acquire(x.node_));
+      return *this;
+    }
+
+    FreeSemiring& operator=(FreeSemiring &&x) {
+      if (this != &x) {
+        SetNode(x.node_);
+        x.node_ = nullptr;
+      }
+      return *this;
+    }
+
     static FreeSemiring null() {
-      return FreeSemiring{factory_.GetEmpty()};
+      return FreeSemiring{NodeFactory::Acquire(factory_.GetEmpty())};
     }
 
     static FreeSemiring one() {
-      return FreeSemiring{factory_.GetEpsilon()};
+      return FreeSemiring{NodeFactory::Acquire(factory_.GetEpsilon())};
     }
 
     FreeSemiring star() const {
       OPSTAR;
-      return FreeSemiring{factory_.NewStar(node_)};
+      return FreeSemiring{factory_.NewStar(node_, laws_)};
     }
 
     FreeSemiring operator+(const FreeSemiring &x) {
       OPADD;
-      return FreeSemiring{factory_.NewAddition(node_, x.node_)};
+      return FreeSemiring{factory_.NewAddition(node_, x.node_, laws_)};
     }
 
     FreeSemiring& operator+=(const FreeSemiring &x) {
       OPADD;
-      node_ = factory_.NewAddition(node_, x.node_);
+      SetNode(factory_.NewAddition(node_, x.node_, laws_));
       return *this;
     }
 
     FreeSemiring operator*(const FreeSemiring &x) {
       OPMULT;
-      return FreeSemiring{factory_.NewMultiplication(node_, x.node_)};
+      return FreeSemiring{factory_.NewMultiplication(node_, x.node_, laws_)};
     }
 
     FreeSemiring& operator*=(const FreeSemiring &x) {
       OPMULT;
-      node_ = factory_.NewMultiplication(node_, x.node_);
+      SetNode(factory_.NewMultiplication(node_, x.node_, laws_));
       return *this;
     }
 
@@ -79,6 +113,9 @@ class FreeSemiring : public StarableSemiring<FreeSemiring, Commutativity::NonCom
     template <typename SR>
     SR Eval(Evaluator<SR> &evaluator) const;
 
+    /* The DAG below all the elements, see CompiledDag. */
+    static CompiledDag Compile(const std::vector<FreeSemiring> &elements);
+
     void PrintDot(std::ostream &out) {
       factory_.PrintDot(out);
     }
@@ -87,15 +124,58 @@ class FreeSemiring : public StarableSemiring<FreeSemiring, Commutativity::NonCom
       factory_.PrintStats(out);
     }
 
-    void GC() {
+    /* Deletes all the nodes that are not reachable from any FreeSemiring. */
+    static void GC() {
       factory_.GC();
     }
 
+    static std::size_t GetNumNodes() {
+      return factory_.GetNumNodes();
+    }
+
+    /* Collect automatically whenever the number of nodes reaches the
+     * threshold (0, the default, turns this off).  The solvers keep most of
+     * the nodes they create alive, so this is meant for long running
+     * processes that solve many systems one after the other. */
+    static void SetGCThreshold(std::size_t nodes) {
+      factory_.SetGCThreshold(nodes);
+    }
+
+    /* While an AssumeLaws exists, the elements built by the thread that
+     * created it are simplified with the given laws (see NodeFactory), which
+     * is correct as long as they are only evaluated in semirings satisfying
+     * them, e.g., the symbolic Jacobian star of the Newton solvers. */
+    class AssumeLaws {
+      public:
+        explicit AssumeLaws(SemiringLaws laws) : previous_(laws_) {
+          laws_ = laws;
+        }
+        ~AssumeLaws() {
+          laws_ = previous_;
+        }
+
+        AssumeLaws(const AssumeLaws &) = delete;
+        AssumeLaws& operator=(const AssumeLaws &) = delete;
+
+      private:
+        const SemiringLaws previous_;
+    };
+
   private:
+    /* Takes over the reference to n. */
     FreeSemiring(NodePtr n) : node_(n) {}
 
+    void SetNode(NodePtr n) {
+      if (node_ != nullptr) {
+        NodeFactory::Release(node_);
+      }
+      node_ = n;
+    }
+
     NodePtr node_;
     static NodeFactory factory_;
+    // per thread, since the SCCs may be solved in parallel
+    static thread_local SemiringLaws laws_;
 
     friend struct std::hash<FreeSemiring>;
 };
@@ -240,11 +320,307 @@ public:
 };
 
 
+/*
+ * DagEvaluator
+ *
+ * Evaluates a CompiledDag by a single pass over its operations into a vector
+ * of values that is allocated once and reused for all the evaluations (so
+ * unlike Evaluator it neither recurses nor allocates every value separately).
+ *
+ * If SR is thread safe and there is a SolverThreadPool, the operations of
+ * every level of the DAG are evaluated in parallel.  Every operation only
+ * writes its own value, so the result does not depend on the number of
+ * threads.
+ */
+template <typename SR>
+class DagEvaluator {
+  public:
+    DagEvaluator(const CompiledDag &dag) : dag_(dag), values_(dag.size(), SR::null()) {}
+
+    /* The values of the roots of the DAG at the valuation (which has to
+     * contain all their variables). */
+    std::vector<SR> Eval(const ValuationMap<SR> &valuation) {
+      auto eval = [this, &valuation](std::size_t i) {
+        if (dag_[i].op == CompiledDag::Op::Element) {
+          auto iter = valuation.find(dag_[i].var);
+          assert(iter != valuation.end());
+          values_[i] = iter->second;
+        } else {
+          values_[i] = EvalOperation(dag_[i], values_);
+        }
+      };
+
+      ThreadPool *pool = IsThreadSafe<SR>::value ? SolverThreadPool() : nullptr;
+      if (pool == nullptr) {
+        for (std::size_t i = 0; i < dag_.size(); ++i) {
+          eval(i);
+        }
+      } else {
+        for (std::size_t l = 0; l < dag_.GetNumLevels(); ++l) {
+          const std::size_t begin = dag_.LevelBegin(l);
+          ParallelFor(pool, dag_.LevelEnd(l) - begin, kMinParallelBlock,
+                      [&eval, begin](std::size_t i) { eval(begin + i); });
+        }
+      }
+      return GetRoots(dag_, values_);
+    }
+
+    /* The value of a non-Element operation from the ones of its operands. */
+    static SR EvalOperation(const CompiledDag::Operation &operation,
+                            const std::vector<SR> &values) {
+      switch (operation.op) {
+        case CompiledDag::Op::Addition:
+          return values[operation.lhs] + values[operation.rhs];
+        case CompiledDag::Op::Multiplication:
+          return values[operation.lhs] * values[operation.rhs];
+        case CompiledDag::Op::Star:
+          return values[operation.lhs].star();
+        case CompiledDag::Op::Epsilon:
+          return SR::one();
+        case CompiledDag::Op::Empty:
+        case CompiledDag::Op::Element:
+          break;
+      }
+      assert(operation.op == CompiledDag::Op::Empty);
+      return SR::null();
+    }
+
+    static std::vector<SR> GetRoots(const CompiledDag &dag, const std::vector<SR> &values) {
+      std::vector<SR> result;
+      result.reserve(dag.GetRoots().size());
+      for (auto i : dag.GetRoots()) {
+        result.push_back(values[i]);
+      }
+      return result;
+    }
+
+    // levels with fewer operations are not split up
+    static constexpr std::size_t kMinParallelBlock = 64;
+
+  private:
+    const CompiledDag &dag_;
+    std::vector<SR> values_;
+};
+
+
+/*
+ * IncrementalEvaluator
+ *
+ * Evaluates a fixed set of elements again and again at valuations that differ
+ * only in some of the variables, e.g., the entries of the symbolic Jacobian in
+ * every Newton step, where only the values of the variables of the system
+ * change (but not the ones standing for the coefficients), and for idempotent
+ * semirings fewer and fewer of them.  The value of every operation of the
+ * compiled DAG is kept between the calls together with the operations using
+ * it, so that the ones depending on a variable are exactly the ones reachable
+ * from its Element.  An operation is only recomputed if the value of one of
+ * its operands has changed, which also stops the propagation at operations
+ * that come out with the same value as before.
+ *
+ * With a thread pool (see DagEvaluator) the dirty operations are recomputed
+ * one level of the DAG at a time in parallel, and only then mark the ones
+ * using them (which are all in later levels).
+ */
+template <typename SR>
+class IncrementalEvaluator {
+  public:
+    IncrementalEvaluator(const std::vector<FreeSemiring> &elements)
+        : dag_(FreeSemiring::Compile(elements)), parents_(dag_.size()),
+          values_(dag_.size(), SR::null()), dirty_(dag_.size(), true),
+          first_(true), recomputed_(0) {
+      for (std::size_t i = 0; i < dag_.size(); ++i) {
+        switch (dag_[i].op) {
+          case CompiledDag::Op::Addition:
+          case CompiledDag::Op::Multiplication:
+            parents_[dag_[i].rhs].push_back(i);
+            // fall through
+          case CompiledDag::Op::Star:
+            parents_[dag_[i].lhs].push_back(i);
+            break;
+          default:
+            break;
+        }
+      }
+    }
+
+    /* The values of the elements at the valuation (which has to contain all
+     * their variables). */
+    std::vector<SR> Eval(const ValuationMap<SR> &valuation) {
+      for (auto i : dag_.GetElements()) {
+        auto iter = valuation.find(dag_[i].var);
+        assert(iter != valuation.end());
+        if (first_ || !(iter->second == values_[i])) {
+          values_[i] = iter->second;
+          MarkParents(i);
+        }
+        dirty_[i] = false;
+      }
+      first_ = false;
+
+      recomputed_ = 0;
+      ThreadPool *pool = IsThreadSafe<SR>::value ? SolverThreadPool() : nullptr;
+      if (pool == nullptr) {
+        // the operands always come before the operations using them
+        for (std::size_t i = 0; i < dag_.size(); ++i) {
+          if (!dirty_[i]) {
+            continue;
+          }
+          dirty_[i] = false;
+          ++recomputed_;
+          SR value = DagEvaluator<SR>::EvalOperation(dag_[i], values_);
+          if (!(value == values_[i])) {
+            values_[i] = std::move(value);
+            MarkParents(i);
+          }
+        }
+      } else {
+        for (std::size_t l = 0; l < dag_.GetNumLevels(); ++l) {
+          level_dirty_.clear();
+          for (std::size_t i = dag_.LevelBegin(l); i < dag_.LevelEnd(l); ++i) {
+            if (dirty_[i]) {
+              dirty_[i] = false;
+              level_dirty_.push_back(i);
+            }
+          }
+          // every operation only writes its own value and flag
+          changed_.assign(level_dirty_.size(), false);
+          ParallelFor(pool, level_dirty_.size(), DagEvaluator<SR>::kMinParallelBlock,
+                      [this](std::size_t k) {
+                        const std::size_t i = level_dirty_[k];
+                        SR value = DagEvaluator<SR>::EvalOperation(dag_[i], values_);
+                        if (!(value == values_[i])) {
+                          values_[i] = std::move(value);
+                          changed_[k] = true;
+                        }
+                      });
+          recomputed_ += level_dirty_.size();
+          for (std::size_t k = 0; k < level_dirty_.size(); ++k) {
+            if (changed_[k]) {
+              MarkParents(level_dirty_[k]);
+            }
+          }
+        }
+      }
+      return DagEvaluator<SR>::GetRoots(dag_, values_);
+    }
+
+    std::size_t GetNumNodes() const { return dag_.size(); }
+
+    // number of operations (other than variables) that were computed again by
+    // the last call to Eval
+    std::size_t GetNumRecomputed() const { return recomputed_; }
+
+  private:
+    void MarkParents(std::size_t index) {
+      for (auto parent : parents_[index]) {
+        dirty_[parent] = true;
+      }
+    }
+
+    const CompiledDag dag_;
+    std::vector< std::vector<std::size_t> > parents_;
+    std::vector<SR> values_;
+    std::vector<bool> dirty_;
+    bool first_;
+    std::size_t recomputed_;
+    // the dirty operations of the current level and whether their values
+    // changed (only used with a thread pool, std::vector<bool> could not be
+    // written concurrently)
+    std::vector<std::size_t> level_dirty_;
+    std::vector<char> changed_;
+};
+
+
+/*
+ * RegisterMachine
+ *
+ * Evaluates a fixed set of elements again and again by running their
+ * RegisterProgram, i.e., a single tight loop with one semiring operation per
+ * instruction on a small array of registers.  Unlike IncrementalEvaluator it
+ * does not keep track of what has changed, so this is the better choice when
+ * the values of (almost) all the variables change between the calls anyway,
+ * e.g., the entries of the Jacobian star in every Newton step over a
+ * non-idempotent semiring.
+ *
+ * The program is inherently sequential (the registers are reused), so with a
+ * thread pool (see DagEvaluator) the levels of the compiled DAG are evaluated
+ * in parallel instead.
+ */
+template <typename SR>
+class RegisterMachine {
+  public:
+    RegisterMachine(const std::vector<FreeSemiring> &elements)
+        : dag_(FreeSemiring::Compile(elements)), program_(dag_),
+          inputs_(program_.GetInputs().size(), SR::null()),
+          registers_(program_.GetNumRegisters(), SR::null()) {}
+
+    /* The values of the elements at the valuation (which has to contain all
+     * their variables). */
+    std::vector<SR> Eval(const ValuationMap<SR> &valuation) {
+      ThreadPool *pool = IsThreadSafe<SR>::value ? SolverThreadPool() : nullptr;
+      if (pool != nullptr && pool->GetNumThreads() > 1) {
+        if (!parallel_) {
+          parallel_.reset(new DagEvaluator<SR>{dag_});
+        }
+        return parallel_->Eval(valuation);
+      }
+
+      for (std::size_t i = 0; i < inputs_.size(); ++i) {
+        auto iter = valuation.find(program_.GetInputs()[i]);
+        assert(iter != valuation.end());
+        inputs_[i] = iter->second;
+      }
+
+      typedef RegisterProgram::Opcode Opcode;
+      for (const auto &instruction : program_.GetInstructions()) {
+        SR &dst = registers_[instruction.dst];
+        switch (instruction.op) {
+          case Opcode::Load:
+            dst = inputs_[instruction.lhs];
+            break;
+          case Opcode::Add:
+            dst = registers_[instruction.lhs] + registers_[instruction.rhs];
+            break;
+          case Opcode::Mul:
+            dst = registers_[instruction.lhs] * registers_[instruction.rhs];
+            break;
+          case Opcode::Star:
+            dst = registers_[instruction.lhs].star();
+            break;
+          case Opcode::One:
+            dst = SR::one();
+            break;
+          case Opcode::Zero:
+            dst = SR::null();
+            break;
+        }
+      }
+
+      std::vector<SR> result;
+      result.reserve(program_.GetOutputs().size());
+      for (auto r : program_.GetOutputs()) {
+        result.push_back(registers_[r]);
+      }
+      return result;
+    }
+
+    std::size_t GetNumInstructions() const { return program_.GetInstructions().size(); }
+    std::size_t GetNumRegisters() const { return program_.GetNumRegisters(); }
+
+  private:
+    const CompiledDag dag_;
+    const RegisterProgram program_;
+    std::vector<SR> inputs_;
+    std::vector<SR> registers_;
+    std::unique_ptr< DagEvaluator<SR> > parallel_;
+};
+
+
 template <typename SR>
 SR FreeSemiring::Eval(const ValuationMap<SR> &valuation) const {
-  Evaluator<SR> evaluator{valuation};
-  node_->Accept(evaluator);
-  return evaluator.GetResult();
+  const CompiledDag dag{std::vector<NodePtr>{node_}};
+  DagEvaluator<SR> evaluator{dag};
+  return evaluator.Eval(valuation)[0];
 }
 
 template <typename SR>
@@ -7,9 +7,14 @@
 #pragma once
 
 #include "semiring.h"
+#include <cstddef>
 #include <string>
 #include <limits>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #define FINFTY (std::numeric_limits<float>::max())
 #define FNEGINFTY (std::numeric_limits<float>::min())
 
@@ -64,6 +69,10 @@ public:
     return MaxMinSemiring{FINFTY};
   }
 
+  float getValue() const {
+    return value_;
+  }
+
   bool isInf(const MaxMinSemiring& elem) const {
     if(FINFTY == elem.value_)
       return true;
@@ -92,3 +101,46 @@ public:
   }
 
 };
+
+template <>
+struct IsThreadSafe<MaxMinSemiring> {
+  static constexpr bool value = true;
+};
+
+template <>
+struct SuperiorSemiring<MaxMinSemiring> {
+  static constexpr bool value = true;
+
+  /* Larger values are better. */
+  static bool Better(const MaxMinSemiring &a, const MaxMinSemiring &b) {
+    return a.getValue() > b.getValue();
+  }
+};
+
+template <>
+struct ScalarSemiring<MaxMinSemiring> {
+  static constexpr bool value = true;
+  typedef float Scalar;
+
+  static Scalar Get(const MaxMinSemiring &elem) { return elem.getValue(); }
+  static MaxMinSemiring Make(Scalar value) { return MaxMinSemiring(value); }
+
+  static Scalar Add(Scalar a, Scalar b) { return b > a ? b : a; }
+  static Scalar Mul(Scalar a, Scalar b) { return b < a ? b : a; }
+  static Scalar Star(Scalar) { return FINFTY; }
+
+  static void AddScaledRow(Scalar *row, Scalar a, const Scalar *other, std::size_t n) {
+    std::size_t c = 0;
+#ifdef __AVX2__
+    const __m256 factor = _mm256_set1_ps(a);
+    for (; c + 8 <= n; c += 8) {
+      const __m256 product = _mm256_min_ps(_mm256_loadu_ps(other + c), factor);
+      const __m256 r = _mm256_loadu_ps(row + c);
+      _mm256_storeu_ps(row + c, _mm256_max_ps(product, r));
+    }
+#endif
+    for (; c < n; ++c) {
+      row[c] = Add(row[c], Mul(a, other[c]));
+    }
+  }
+};
@@ -132,6 +132,11 @@ class PrecRatSemiring : public StarableSemiring<PrecRatSemiring,
 
 };
 
+template <>
+struct IsThreadSafe<PrecRatSemiring> {
+  static constexpr bool value = true;
+};
+
 
 
 #endif /* MPR_FLOAT_SEMIRING_H_ */
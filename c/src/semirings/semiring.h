@@ -1,6 +1,7 @@
 #ifndef SEMIRING_H
 #define SEMIRING_H
 
+#include <cstddef>
 #include <iosfwd>
 #include <string>
 #include <functional> // for std::hash
@@ -155,6 +156,56 @@ std::ostream& operator<<(std::ostream& os, const Semiring<SR, Comm, Idem>& elem)
 }
 
 
+/* Tells whether elements of SR can be added, multiplied and starred by
+ * several threads at the same time (for different elements).  This is not the
+ * case for semirings that keep global state (e.g., hash-consing of the
+ * elements).  Semirings that are safe must specialize this trait. */
+template <typename SR>
+struct IsThreadSafe {
+  static constexpr bool value = false;
+};
+
+
+/* Semirings whose elements are just a single scalar can specialize this trait
+ * (with value = true) to let Matrix work on plain arrays of the scalars (see
+ * datastructs/matrix_kernels.h).  A specialization has to provide:
+ *   typedef ... Scalar;
+ *   static Scalar Get(const SR &elem);  static SR Make(Scalar value);
+ *   static Scalar Add(Scalar a, Scalar b);  static Scalar Mul(Scalar a, Scalar b);
+ *   static Scalar Star(Scalar a);
+ *   static void AddScaledRow(Scalar *row, Scalar a, const Scalar *other, std::size_t n);
+ * with the same semantics as the operations of SR, where AddScaledRow computes
+ * row[c] = Add(row[c], Mul(a, other[c])) for all c < n (this is the inner loop
+ * of all the matrix operations, so it may be vectorized explicitly).  Star and
+ * AddScaledRow are not needed if ScalarMatrixKernels<SR> is specialized as
+ * well. */
+template <typename SR>
+struct ScalarSemiring {
+  static constexpr bool value = false;
+};
+
+/* Semirings whose addition picks the better of two elements w.r.t. a total
+ * order (i.e., a + b is always a or b) and where multiplying never gives
+ * anything better than the factors, as long as the coefficients are not
+ * better than one(), can specialize this trait (with value = true) to enable
+ * the Knuth solver (see solvers/knuth.h).  A specialization has to provide
+ *   static bool Better(const SR &a, const SR &b);
+ * which is true iff a + b == a and a != b. */
+template <typename SR>
+struct SuperiorSemiring {
+  static constexpr bool value = false;
+};
+
+/* Plain loop for ScalarSemiring<SR>::AddScaledRow. */
+template <typename Traits>
+inline void GenericAddScaledRow(typename Traits::Scalar *row, typename Traits::Scalar a,
+                                const typename Traits::Scalar *other, std::size_t n) {
+  for (std::size_t c = 0; c < n; ++c) {
+    row[c] = Traits::Add(row[c], Traits::Mul(a, other[c]));
+  }
+}
+
+
 template <typename SR, Commutativity Comm, Idempotence Idem>
 class StarableSemiring : public Semiring<SR, Comm, Idem>{
 public:
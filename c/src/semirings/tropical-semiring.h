@@ -8,11 +8,17 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <limits>
 #include "semiring.h"
 #include <string>
 #include <memory>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #define INFTY (std::numeric_limits<int>::max())
 #define NEGINFTY (std::numeric_limits<int>::min())
 
@@ -35,6 +41,10 @@ public:
   static TropicalSemiring one();  // zero (natural number)
   std::string string() const;
 
+  int getValue() const {
+    return val;
+  }
+
   bool isInf(const TropicalSemiring& elem) const {
     if(INFTY == elem.val)
       return true;
@@ -49,3 +59,67 @@ public:
       return false;
   }
 };
+
+template <>
+struct IsThreadSafe<TropicalSemiring> {
+  static constexpr bool value = true;
+};
+
+template <>
+struct SuperiorSemiring<TropicalSemiring> {
+  static constexpr bool value = true;
+
+  /* Smaller values are better. */
+  static bool Better(const TropicalSemiring &a, const TropicalSemiring &b) {
+    return a.getValue() < b.getValue();
+  }
+};
+
+template <>
+struct ScalarSemiring<TropicalSemiring> {
+  static constexpr bool value = true;
+  typedef int Scalar;
+
+  static Scalar Get(const TropicalSemiring &elem) { return elem.getValue(); }
+  static TropicalSemiring Make(Scalar value) { return TropicalSemiring(value); }
+
+  static Scalar Add(Scalar a, Scalar b) { return std::min(a, b); }
+
+  static Scalar Mul(Scalar a, Scalar b) {
+    if (a == INFTY || b == INFTY) {
+      return INFTY;
+    }
+    if (a == NEGINFTY || b == NEGINFTY) {
+      return NEGINFTY;
+    }
+    return a + b;
+  }
+
+  static Scalar Star(Scalar a) { return a < 0 ? NEGINFTY : 0; }
+
+  static void AddScaledRow(Scalar *row, Scalar a, const Scalar *other, std::size_t n) {
+    std::size_t c = 0;
+#ifdef __AVX2__
+    // a == -inf is rare, it is left to the plain loop
+    if (a == INFTY) {
+      return; // row[c] = min(row[c], inf)
+    }
+    if (a != NEGINFTY) {
+      const __m256i inf = _mm256_set1_epi32(INFTY);
+      const __m256i neg_inf = _mm256_set1_epi32(NEGINFTY);
+      const __m256i factor = _mm256_set1_epi32(a);
+      for (; c + 8 <= n; c += 8) {
+        const __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other + c));
+        const __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + c));
+        __m256i product = _mm256_add_epi32(factor, o);
+        product = _mm256_blendv_epi8(product, neg_inf, _mm256_cmpeq_epi32(o, neg_inf));
+        product = _mm256_blendv_epi8(product, inf, _mm256_cmpeq_epi32(o, inf));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(row + c), _mm256_min_epi32(r, product));
+      }
+    }
+#endif
+    for (; c < n; ++c) {
+      row[c] = Add(row[c], Mul(a, other[c]));
+    }
+  }
+};
@@ -7,11 +7,17 @@
 #pragma once
 
 #include "semiring.h"
+#include <algorithm>
 #include <string>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
 #include <limits>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 class ViterbiSemiring : public StarableSemiring<ViterbiSemiring, Commutativity::Commutative, Idempotence::Idempotent>{
 private:
   float value_;
@@ -67,9 +73,56 @@ public:
     return ViterbiSemiring{1.0};
   }
 
+  float getValue() const {
+    return value_;
+  }
+
   std::string string() const {
     std::stringstream ss;
     ss << value_;
     return ss.str();
   }
 };
+
+template <>
+struct IsThreadSafe<ViterbiSemiring> {
+  static constexpr bool value = true;
+};
+
+template <>
+struct SuperiorSemiring<ViterbiSemiring> {
+  static constexpr bool value = true;
+
+  /* Larger values are better. */
+  static bool Better(const ViterbiSemiring &a, const ViterbiSemiring &b) {
+    return a.getValue() > b.getValue();
+  }
+};
+
+template <>
+struct ScalarSemiring<ViterbiSemiring> {
+  static constexpr bool value = true;
+  typedef float Scalar;
+
+  static Scalar Get(const ViterbiSemiring &elem) { return elem.getValue(); }
+  static ViterbiSemiring Make(Scalar value) { return ViterbiSemiring(value); }
+
+  static Scalar Add(Scalar a, Scalar b) { return b > a ? b : a; }
+  static Scalar Mul(Scalar a, Scalar b) { return a * b; }
+  static Scalar Star(Scalar) { return 1.0f; }
+
+  static void AddScaledRow(Scalar *row, Scalar a, const Scalar *other, std::size_t n) {
+    std::size_t c = 0;
+#ifdef __AVX2__
+    const __m256 factor = _mm256_set1_ps(a);
+    for (; c + 8 <= n; c += 8) {
+      const __m256 product = _mm256_mul_ps(factor, _mm256_loadu_ps(other + c));
+      const __m256 r = _mm256_loadu_ps(row + c);
+      _mm256_storeu_ps(row + c, _mm256_max_ps(product, r));
+    }
+#endif
+    for (; c < n; ++c) {
+      row[c] = Add(row[c], Mul(a, other[c]));
+    }
+  }
+};
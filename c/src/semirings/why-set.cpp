@@ -83,18 +83,17 @@ WhySemiring WhySemiring::star() const
   return (one() + pow(tmp,N));
 }
 
+// the initialization of local statics is thread safe
 WhySemiring WhySemiring::null()
 {
-  if(!WhySemiring::elem_null)
-    WhySemiring::elem_null = std::shared_ptr<WhySemiring>(new WhySemiring("0"));
-  return *WhySemiring::elem_null;
+  static const WhySemiring elem_null{std::string("0")};
+  return elem_null;
 }
 
 WhySemiring WhySemiring::one()
 {
-  if(!WhySemiring::elem_one)
-    WhySemiring::elem_one = std::shared_ptr<WhySemiring>(new WhySemiring("1"));
-  return *WhySemiring::elem_one;
+  static const WhySemiring elem_one{std::string("1")};
+  return elem_one;
 }
 
 std::string WhySemiring::string() const
@@ -113,5 +112,3 @@ VarSet WhySemiring::getVars() const {
   return res;
 }
 
-std::shared_ptr<WhySemiring> WhySemiring::elem_null;
-std::shared_ptr<WhySemiring> WhySemiring::elem_one;
@@ -23,8 +23,6 @@ class WhySemiring : public StarableSemiring<WhySemiring, Commutativity::Commutat
 
 private:
   WhySet val;
-  static std::shared_ptr<WhySemiring> elem_null;
-  static std::shared_ptr<WhySemiring> elem_one;
 public:
   WhySemiring();
   WhySemiring(VarId v);
@@ -40,6 +38,12 @@ public:
   std::string string() const;
 };
 
+/* The elements are plain sets without any shared state. */
+template <>
+struct IsThreadSafe<WhySemiring> {
+  static constexpr bool value = true;
+};
+
 
 
 #endif /* WHY_SET_H_ */
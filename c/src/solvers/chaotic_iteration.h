@@ -0,0 +1,143 @@
+/*
+ * chaotic_iteration.h
+ *
+ * Gauss-Seidel style (chaotic) Kleene iteration along a weak topological
+ * ordering of the dependency graph.
+ */
+
+#ifndef CHAOTIC_ITERATION_H_
+#define CHAOTIC_ITERATION_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "../datastructs/equations.h"
+#include "../datastructs/var.h"
+#include "../datastructs/weak_topological_order.h"
+#include "../polynomials/commutative_polynomial.h"
+#include "../polynomials/compiled_polynomial.h"
+
+/*
+ * In contrast to KleeneSeminaive (which computes all the new values from the
+ * ones of the previous round) every polynomial is evaluated with the newest
+ * values of its variables.  The variables are visited in a weak topological
+ * order of the dependency graph (edges from every variable to the polynomials
+ * it occurs in) using the recursive strategy of Bourdoncle, i.e., every
+ * component is iterated until its head is stable, and a polynomial is only
+ * evaluated again if one of its variables has changed since its last
+ * evaluation.
+ *
+ * For semirings where the Kleene iteration becomes stable (e.g., idempotent
+ * ones of finite height) this stops with the least solution as soon as no
+ * variable changes anymore.  Otherwise every polynomial is evaluated at most
+ * max_iter + 1 times (as often as by KleeneSeminaive with max_iter), after
+ * that its variable keeps its value.  Since every evaluation sees values that
+ * are at least as large as the ones of the corresponding Kleene round, the
+ * result is never smaller than the one of KleeneSeminaive.
+ */
+template <typename SR>
+class ChaoticIteration {
+  public:
+    ChaoticIteration() : iterations_(0), evaluations_(0) {}
+
+    // largest number of times a single polynomial was evaluated again after
+    // its first evaluation, bounded by max_iter like the rounds of
+    // KleeneSeminaive
+    std::size_t GetIterations() const { return iterations_; }
+
+    // number of evaluations of single polynomials
+    std::size_t GetEvaluations() const { return evaluations_; }
+
+    ValuationMap<SR> solve_fixpoint(
+        const GenericEquations<CommutativePolynomial, SR> &equations, int max_iter) {
+
+      std::vector< CommutativePolynomial<SR> > F;
+      std::vector<VarId> poly_vars;
+      for (const auto &eq : equations) {
+        poly_vars.push_back(eq.first);
+        F.push_back(eq.second);
+      }
+      const std::size_t n = poly_vars.size();
+      const CompiledPolynomialSystem<SR> F_compiled{F, poly_vars};
+
+      // dependents[j] are the polynomials in which variable j occurs
+      const auto dependents = F_compiled.Dependents();
+      const WeakTopologicalOrder wto{dependents};
+
+      State state{F_compiled, dependents, std::vector<SR>(n, SR::null()),
+                  std::vector<bool>(n, true), std::vector<std::size_t>(n, 0),
+                  max_iter >= 0 ? static_cast<std::size_t>(max_iter) + 1 : 0};
+      Stabilize(wto, 0, wto.size(), state);
+
+      evaluations_ = 0;
+      iterations_ = 0;
+      for (auto count : state.evaluations) {
+        evaluations_ += count;
+        iterations_ = std::max(iterations_, count > 0 ? count - 1 : 0);
+      }
+
+      ValuationMap<SR> result;
+      for (std::size_t i = 0; i < n; ++i) {
+        result.insert({poly_vars[i], state.values[i]});
+      }
+      return result;
+    }
+
+  private:
+    struct State {
+      const CompiledPolynomialSystem<SR> &F;
+      const std::vector< std::vector<std::size_t> > &dependents;
+      std::vector<SR> values;
+      // the variables that occur in polynomial i changed since its last
+      // evaluation (and it may still be evaluated)
+      std::vector<bool> dirty;
+      std::vector<std::size_t> evaluations;
+      std::size_t max_evaluations;
+    };
+
+    /* Evaluates polynomial i if necessary. */
+    static void Update(std::size_t i, State &state) {
+      if (!state.dirty[i]) {
+        return;
+      }
+      state.dirty[i] = false;
+      if (state.evaluations[i] == state.max_evaluations) {
+        return;
+      }
+      ++state.evaluations[i];
+      SR value = state.F.eval(i, state.values);
+      if (!(value == state.values[i])) {
+        state.values[i] = std::move(value);
+        for (auto k : state.dependents[i]) {
+          state.dirty[k] = true;
+        }
+      }
+    }
+
+    /* Iterates the positions [begin, end) of the order (the recursive
+     * strategy). */
+    static void Stabilize(const WeakTopologicalOrder &wto, std::size_t begin,
+                          std::size_t end, State &state) {
+      std::size_t p = begin;
+      while (p < end) {
+        const std::size_t v = wto.Vertex(p);
+        if (wto.IsHead(p)) {
+          // all edges back into the component go to its head, so it is
+          // stable once the head does not have to be evaluated again
+          do {
+            Update(v, state);
+            Stabilize(wto, p + 1, wto.ComponentEnd(p), state);
+          } while (state.dirty[v] && state.evaluations[v] < state.max_evaluations);
+          p = wto.ComponentEnd(p);
+        } else {
+          Update(v, state);
+          ++p;
+        }
+      }
+    }
+
+    std::size_t iterations_;
+    std::size_t evaluations_;
+};
+
+#endif /* CHAOTIC_ITERATION_H_ */
@@ -0,0 +1,111 @@
+/*
+ * horn.h
+ *
+ * Linear time solver for boolean systems (Dowling and Gallier, "Linear-time
+ * algorithms for testing the satisfiability of propositional Horn formulae",
+ * 1984).
+ */
+
+#ifndef HORN_H_
+#define HORN_H_
+
+#include <type_traits>
+#include <vector>
+
+#include "../datastructs/equations.h"
+#include "../datastructs/var.h"
+#include "../polynomials/commutative_polynomial.h"
+#include "../polynomials/compiled_polynomial.h"
+#include "../semirings/bool-semiring.h"
+
+/*
+ * Over the boolean semiring every monomial X_1 ... X_k with coefficient true
+ * of the equation for X is the Horn clause X_1 & ... & X_k -> X, and the least
+ * solution is the set of variables derived by unit propagation.  Every
+ * monomial keeps a counter of its variables that are not yet known to be
+ * true, a variable that becomes true is put on a worklist and decrements the
+ * counters of all the monomials it occurs in.  When a counter drops to zero
+ * the variable of the equation becomes true.  Every monomial and every
+ * occurrence of a variable is touched only once, so this takes time linear in
+ * the size of the system.
+ */
+template <typename SR>
+class HornSolver {
+  static_assert(std::is_same<SR, BoolSemiring>::value,
+                "the Horn solver is only defined for the boolean semiring");
+
+  public:
+    HornSolver() : iterations_(0) {}
+
+    // number of variables that are true in the last solution
+    std::size_t GetIterations() const { return iterations_; }
+
+    // the propagation always terminates with the exact result, so max_iter
+    // is not used
+    ValuationMap<SR> solve_fixpoint(
+        const GenericEquations<CommutativePolynomial, SR> &equations, int /* max_iter */) {
+
+      std::vector< CommutativePolynomial<SR> > F;
+      std::vector<VarId> poly_vars;
+      for (const auto &eq : equations) {
+        poly_vars.push_back(eq.first);
+        F.push_back(eq.second);
+      }
+      const std::size_t n = poly_vars.size();
+      const CompiledPolynomialSystem<SR> F_compiled{F, poly_vars};
+
+      // owner[m] is the variable of the equation of monomial m and missing[m]
+      // the number of its variables that are not true yet
+      const std::size_t num_monomials = F_compiled.GetNumMonomials();
+      std::vector<std::size_t> owner(num_monomials);
+      std::vector<std::size_t> missing(num_monomials);
+      for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t m = F_compiled.MonomialBegin(i); m < F_compiled.MonomialEnd(i); ++m) {
+          owner[m] = i;
+          missing[m] = F_compiled.FactorEnd(m) - F_compiled.FactorBegin(m);
+        }
+      }
+      std::vector<std::size_t> occurrence_begin;
+      std::vector<std::size_t> occurrences;
+      F_compiled.MonomialOccurrences(occurrence_begin, occurrences);
+
+      std::vector<bool> value(n, false);
+      std::vector<std::size_t> worklist;
+      auto derive = [&](std::size_t m) {
+        const std::size_t i = owner[m];
+        if (!value[i] && F_compiled.GetCoefficient(m).getValue()) {
+          value[i] = true;
+          worklist.push_back(i);
+        }
+      };
+
+      for (std::size_t m = 0; m < num_monomials; ++m) {
+        if (missing[m] == 0) {
+          derive(m);
+        }
+      }
+      while (!worklist.empty()) {
+        const std::size_t i = worklist.back();
+        worklist.pop_back();
+        for (std::size_t o = occurrence_begin[i]; o < occurrence_begin[i + 1]; ++o) {
+          const std::size_t m = occurrences[o];
+          if (--missing[m] == 0) {
+            derive(m);
+          }
+        }
+      }
+
+      iterations_ = 0;
+      ValuationMap<SR> result;
+      for (std::size_t i = 0; i < n; ++i) {
+        iterations_ += value[i];
+        result.insert({poly_vars[i], SR(value[i])});
+      }
+      return result;
+    }
+
+  private:
+    std::size_t iterations_;
+};
+
+#endif /* HORN_H_ */
@@ -9,8 +9,10 @@
 #define KLEENE_SEMINAIVE_H_
 
 
+#include <algorithm>
 #include <vector>
 #include "../datastructs/var.h"
+#include "../polynomials/compiled_polynomial.h"
 
 // Polynomial is parametrized by a semiring
 #define POLY_TYPE template <typename> class
@@ -19,19 +21,34 @@ template <typename SR, POLY_TYPE Poly>
 class KleeneSeminaive {
 
 public:
+  KleeneSeminaive() : iterations_(0) {}
+
+  // number of iterations done by the last call to solve_fixpoint (it stops
+  // as soon as all updates are zero)
+  std::size_t GetIterations() const { return iterations_; }
+
   /*
    * Init:
    * previous_values = 0
    * values = F(0)
    * update = F(0)
    *
-   * precompute polynomials.HeightUnfolding()
-   *
    * Each iteration consists of :
    *
    * update = evaluate the height unfolding at respective values
    * previous_values = values
    * values = values + update
+   *
+   * The height unfolding (see CommutativeMonomial::HeightUnfolding) is not
+   * constructed, CompiledPolynomialSystem::EvalHeightUnfolding evaluates it
+   * directly from the monomials of F at the three valuations X^{=h} (update),
+   * X^{<h} (previous_values) and X^{<h+1} (values).
+   *
+   * Every monomial of the height unfolding contains exactly one X^{=h}
+   * variable, so the update of X_i can only be nonzero if some variable of
+   * F_i got a nonzero update in the previous iteration (F_i is "dirty").  The
+   * other polynomials are not evaluated, and once no polynomial is dirty the
+   * values cannot change anymore.
   */
   ValuationMap<SR> solve_fixpoint(const GenericEquations<Poly, SR>& equations, int max_iter) {
 
@@ -43,82 +60,66 @@ public:
       F.push_back(eq.second);
     }
 
-    std::vector<Poly<SR> > unfolded_polys;
-
-    // we use the original poly_vars for the "X^{=h+1}"-variables
-    SubstitutionMap prev_val_map; // X^{<h}
-    SubstitutionMap val_map;      // X^{<h+1}
-
-    //std::cout << "Unfolding polys" << std::endl;
-    for (const Poly<SR> f : F) {
-      //the new anonymous unfolding-variables are accumulated in the two maps!
-      Poly<SR> t = f.HeightUnfolding(prev_val_map, val_map);
-      unfolded_polys.push_back(t);
-      //std::cout << t << std::endl;
-    }
-
-    //std::cout << "Unfolding done!" << std::endl;
-    //for (int i=0; i<poly_vars.size(); i++)
-    //  std::cout << poly_vars[i] << std::endl;
-
-    //std::cout << prev_val_map<< std::endl;
-    //std::cout << val_map<< std::endl;
-
-    //TODO: use vectors for better cache efficiency?
-
-    // valuations of X^{<h},  X^{<h+1}, and X (representing X^{=h+1})
-    // keep all in one map to pass it easily to eval
-    ValuationMap<SR> all_values;
-    ValuationMap<SR> updates;
-
-
-    ValuationMap<SR> zeros;
-    for (const auto v : poly_vars) {
-      zeros.insert({v, SR::null()});
-    }
-
-    // Init all values, note that they all talk about different variable names (connected via the two maps above)
-
-    for (unsigned int i=0; i<poly_vars.size(); ++i) {
-      SR f_0 = F[i].eval(zeros);
-      // check if variable does appear in the rhs of some eqn!
-      if(val_map.find(poly_vars[i]) == val_map.end()) {
-        // var does not appear (i.e. it is a "start-symbol" or "sink" only)
-        VarId tmp = Var::GetVarId(); // get fresh variables, this avoids missing updates to all_values below
-        VarId tmp2 = Var::GetVarId();
-        val_map.insert({poly_vars[i],tmp});
-        prev_val_map.insert({poly_vars[i],tmp2});
+    const std::size_t n = poly_vars.size();
+    CompiledPolynomialSystem<SR> F_compiled{F, poly_vars};
+
+    // X^{<h}, X^{<h+1} and X^{=h}, all indexed like poly_vars
+    std::vector<SR> previous_values(n, SR::null());
+    std::vector<SR> values = F_compiled.eval(previous_values);
+    std::vector<SR> updates = values;
+    std::vector<SR> new_updates(n);
+
+    // dependents[j] are the polynomials in which X_j occurs
+    const auto dependents = F_compiled.Dependents();
+    std::vector<bool> dirty(n, false);
+    std::size_t num_dirty = 0;
+    auto mark_dependents = [&](std::size_t j) {
+      for (auto i : dependents[j]) {
+        num_dirty += !dirty[i];
+        dirty[i] = true;
+      }
+    };
+    for (unsigned int j=0; j<n; ++j) {
+      if (!(updates[j] == SR::null())) {
+        mark_dependents(j);
       }
-
-      all_values.insert({poly_vars[i], f_0});
-      all_values.insert({prev_val_map.at(poly_vars[i]), SR::null()});
-      all_values.insert({val_map.at(poly_vars[i]), f_0});
-
     }
 
+    unsigned int iter = 0;
+    for (; iter < max_iter && num_dirty > 0; ++iter) {
 
-    for (unsigned int n=0; n < max_iter; ++n) {
-
-      for (unsigned int i=0; i<poly_vars.size(); ++i) {
-      // compute new update, note that we cannot modify all_values, yet!
-        updates[poly_vars[i]] = unfolded_polys[i].eval(all_values);
+      for (unsigned int i=0; i<n; ++i) {
+      // compute new update, note that we cannot modify the values, yet!
+        new_updates[i] = dirty[i]
+          ? F_compiled.EvalHeightUnfolding(i, previous_values, values, updates)
+          : SR::null();
       }
 
       // now all effects have been computed -> update the valuation
-      for (unsigned int i=0; i<poly_vars.size(); ++i) {
-        all_values.at(poly_vars[i]) = updates.at(poly_vars[i]);
-        all_values.at(prev_val_map.at(poly_vars[i])) = all_values.at(val_map.at(poly_vars[i])); //save vals
-        all_values.at(val_map.at(poly_vars[i])) += all_values.at(poly_vars[i]); // add update to vals
+      std::fill(dirty.begin(), dirty.end(), false);
+      num_dirty = 0;
+      updates.swap(new_updates);
+      for (unsigned int i=0; i<n; ++i) {
+        previous_values[i] = values[i]; //save vals
+        values[i] += updates[i]; // add update to vals
+        if (!(updates[i] == SR::null())) {
+          mark_dependents(i);
+        }
       }
     }
 
+    iterations_ = iter;
+
     ValuationMap<SR> result;
-    for (unsigned int i=0; i<poly_vars.size(); ++i) {
-      result.insert({poly_vars[i], all_values.at(val_map.at(poly_vars[i]))});
+    for (unsigned int i=0; i<n; ++i) {
+      result.insert({poly_vars[i], values[i]});
     }
 
     return result;
   }
+
+private:
+  std::size_t iterations_;
 };
 
 // compatability with old implementation
@@ -0,0 +1,133 @@
+/*
+ * knuth.h
+ *
+ * Knuth's generalization of Dijkstra's algorithm to grammar problems
+ * (D. E. Knuth, "A generalization of Dijkstra's algorithm", 1977).
+ */
+
+#ifndef KNUTH_H_
+#define KNUTH_H_
+
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "../datastructs/equations.h"
+#include "../datastructs/var.h"
+#include "../polynomials/commutative_polynomial.h"
+#include "../polynomials/compiled_polynomial.h"
+#include "../semirings/semiring.h"
+
+#include "newton_generic.h"
+
+/*
+ * Solver for semirings with SuperiorSemiring<SR>::value (tropical, Viterbi,
+ * max-min), where every monomial is at most as good as each of its variables.
+ * Then the best tentative value of all unsettled variables cannot be improved
+ * anymore, so the variables are settled in the order of their values using a
+ * priority queue, and every monomial is evaluated exactly once, when its last
+ * variable is settled.  This needs O(m log m) time for a system of size m
+ * instead of the n+1 Newton steps (each with a star of an n x n matrix).
+ *
+ * If some coefficient is better than one() (e.g., negative weights in the
+ * tropical semiring) the monomials are not superior and we fall back to
+ * NewtonCLDU.
+ */
+template <typename SR>
+class KnuthSolver {
+  static_assert(SuperiorSemiring<SR>::value,
+                "the Knuth solver needs a superior semiring");
+
+  public:
+    KnuthSolver() : iterations_(0) {}
+
+    // number of variables settled by the last call to solve_fixpoint (or the
+    // iterations of Newton if it was used instead)
+    std::size_t GetIterations() const { return iterations_; }
+
+    // the result is exact, max_iter is only used by the fallback
+    ValuationMap<SR> solve_fixpoint(
+        const GenericEquations<CommutativePolynomial, SR> &equations, int max_iter) {
+
+      std::vector< CommutativePolynomial<SR> > F;
+      std::vector<VarId> poly_vars;
+      for (const auto &eq : equations) {
+        poly_vars.push_back(eq.first);
+        F.push_back(eq.second);
+      }
+      const std::size_t n = poly_vars.size();
+      const CompiledPolynomialSystem<SR> F_compiled{F, poly_vars};
+
+      // owner[m] is the polynomial of monomial m and missing[m] the number of
+      // its variables that are not settled yet
+      const std::size_t num_monomials = F_compiled.GetNumMonomials();
+      std::vector<std::size_t> owner(num_monomials);
+      std::vector<std::size_t> missing(num_monomials);
+      for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t m = F_compiled.MonomialBegin(i); m < F_compiled.MonomialEnd(i); ++m) {
+          if (SuperiorSemiring<SR>::Better(F_compiled.GetCoefficient(m), SR::one())) {
+            NewtonCLDU<SR> newton;
+            auto result = newton.solve_fixpoint(equations, max_iter);
+            iterations_ = newton.GetIterations();
+            return result;
+          }
+          owner[m] = i;
+          missing[m] = F_compiled.FactorEnd(m) - F_compiled.FactorBegin(m);
+        }
+      }
+      std::vector<std::size_t> occurrence_begin;
+      std::vector<std::size_t> occurrences;
+      F_compiled.MonomialOccurrences(occurrence_begin, occurrences);
+
+      // (tentative value, variable), the best value is on top; outdated
+      // entries are skipped when they are popped
+      typedef std::pair<SR, std::size_t> Entry;
+      auto worse = [](const Entry &a, const Entry &b) {
+        return SuperiorSemiring<SR>::Better(b.first, a.first);
+      };
+      std::priority_queue<Entry, std::vector<Entry>, decltype(worse)> queue{worse};
+
+      std::vector<SR> values(n, SR::null());
+      std::vector<bool> settled(n, false);
+      auto relax = [&](std::size_t i, const SR &value) {
+        if (!settled[i] && SuperiorSemiring<SR>::Better(value, values[i])) {
+          values[i] = value;
+          queue.push(Entry{value, i});
+        }
+      };
+
+      for (std::size_t m = 0; m < num_monomials; ++m) {
+        if (missing[m] == 0) {
+          relax(owner[m], F_compiled.GetCoefficient(m));
+        }
+      }
+
+      iterations_ = 0;
+      while (!queue.empty()) {
+        const std::size_t i = queue.top().second;
+        queue.pop();
+        if (settled[i]) {
+          continue;
+        }
+        settled[i] = true;
+        ++iterations_;
+        for (std::size_t o = occurrence_begin[i]; o < occurrence_begin[i + 1]; ++o) {
+          const std::size_t m = occurrences[o];
+          if (--missing[m] == 0) {
+            relax(owner[m], F_compiled.EvalMonomial(m, values));
+          }
+        }
+      }
+
+      ValuationMap<SR> result;
+      for (std::size_t i = 0; i < n; ++i) {
+        result.insert({poly_vars[i], values[i]});
+      }
+      return result;
+    }
+
+  private:
+    std::size_t iterations_;
+};
+
+#endif /* KNUTH_H_ */
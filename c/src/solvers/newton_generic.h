@@ -11,16 +11,22 @@
 #include <algorithm>
 #include <cstdint>
 #include <fstream>
+#include <numeric>
+#include <type_traits>
 
 #include "../datastructs/matrix.h"
+#include "../datastructs/sparse_ordering.h"
 #include "../datastructs/var_degree_map.h"
 
 #include "../matrix_free_semiring.h"
 
 #include "../polynomials/commutative_polynomial.h"
+#include "../polynomials/compiled_polynomial.h"
 
+#include "../semirings/free-semiring-cache.h"
 #include "../semirings/semiring.h"
 #include "../semirings/float-semiring.h"
+#include "../semirings/prec-rat-semiring.h"
 
 
 // Lin_Eq_Solver is parametrized by a semiring
@@ -32,23 +38,133 @@
 // Polynomial is parametrized by a semiring
 #define POLY_TYPE template <typename> class
 
+// Convergence criterion is parametrized by a semiring
+#define CONVERGENCE_TYPE template <typename> class
+
+
+/*
+ * Stopping criteria for the Newton iteration.  Converged() is called after
+ * every iteration with the previous and the current Newton iterate and decides
+ * whether solve_fixpoint may stop before max_iter iterations.
+ *
+ * By default only idempotent semirings stop early: in that case the next
+ * iterate depends only on the current one (delta is always F(0)), so once the
+ * iterate is stable it stays stable.
+ */
+template <typename SR>
+struct NewtonConvergence {
+  static bool Converged(const CompiledPolynomialSystem<SR> &,
+                        const Matrix<SR> &previous, const Matrix<SR> &current) {
+    return SR::IsIdempotent() && previous == current;
+  }
+};
+
+/*
+ * For numeric semirings we stop as soon as the residual F(x) - x of the
+ * current iterate x is small enough, i.e., for every component
+ *   |F(x)_i - x_i| <= tolerance * max(1, |x_i|)
+ * Components that are already infinite have converged if they were infinite
+ * in the previous iterate as well.
+ */
+template <typename SR>
+bool ResidualWithinTolerance(const CompiledPolynomialSystem<SR> &F,
+                             const Matrix<SR> &previous,
+                             const Matrix<SR> &current, double tolerance) {
+  typedef decltype(SR::null().getValue()) Value;
+  assert(current.getColumns() == 1 && current.getRows() == F.size());
+
+  for (std::size_t i = 0; i < F.size(); ++i) {
+    if (SR::isInf(current.At(i, 0)) && !SR::isInf(previous.At(i, 0))) {
+      return false;
+    }
+  }
+
+  const Value tol(tolerance);
+  const Value unit(1);
+  Matrix<SR> F_x = F.eval(current);
+  for (std::size_t i = 0; i < F.size(); ++i) {
+    if (SR::isInf(current.At(i, 0))) {
+      continue;
+    }
+    if (SR::isInf(F_x.At(i, 0))) {
+      return false;
+    }
+    const Value x = current.At(i, 0).getValue();
+    const Value residual = F_x.At(i, 0).getValue() - x;
+    const Value bound = tol * (x > unit ? x : unit);
+    if (residual > bound || -residual > bound) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <>
+struct NewtonConvergence<FloatSemiring> {
+  static constexpr double tolerance = 1e-12;
+
+  static bool Converged(const CompiledPolynomialSystem<FloatSemiring> &F,
+                        const Matrix<FloatSemiring> &previous,
+                        const Matrix<FloatSemiring> &current) {
+    return ResidualWithinTolerance(F, previous, current, tolerance);
+  }
+};
+
+template <>
+struct NewtonConvergence<PrecRatSemiring> {
+  static constexpr double tolerance = 1e-12;
+
+  static bool Converged(const CompiledPolynomialSystem<PrecRatSemiring> &F,
+                        const Matrix<PrecRatSemiring> &previous,
+                        const Matrix<PrecRatSemiring> &current) {
+    return ResidualWithinTolerance(F, previous, current, tolerance);
+  }
+};
+
 
 template <typename SR,
           LIN_EQ_SOLVER_TYPE LinEqSolverTemplate,
           DELTA_GEN_TYPE DeltaGeneratorTemplate,
-          POLY_TYPE Poly>
+          POLY_TYPE Poly,
+          CONVERGENCE_TYPE ConvergenceTemplate = NewtonConvergence>
 class GenericNewton {
   typedef LinEqSolverTemplate<SR> LinEqSolver;
   typedef DeltaGeneratorTemplate<SR> DeltaGenerator;
+  typedef ConvergenceTemplate<SR> Convergence;
 
   public:
 
+  GenericNewton() : iterations_(0) {}
+
+  // number of iterations done by the last call to solve_fixpoint
+  std::size_t GetIterations() const { return iterations_; }
+
   ValuationMap<SR> solve_fixpoint(const GenericEquations<Poly, SR>& equations, int max_iter) {
+    return solve_fixpoint(equations, max_iter, DefaultVariableOrdering());
+  }
+
+  // the equations are permuted by the given fill-reducing ordering before
+  // solving; since the result is keyed by the variables, no inverse
+  // permutation is necessary
+  ValuationMap<SR> solve_fixpoint(const GenericEquations<Poly, SR>& equations,
+                                  int max_iter, VariableOrdering ordering) {
+    std::vector<VarId> input_vars;
+    for (const auto &eq : equations) {
+      input_vars.push_back(eq.first);
+    }
+    // the dependency pattern is only needed for an actual reordering
+    std::vector<std::size_t> order(equations.size());
+    if (ordering == VariableOrdering::None) {
+      std::iota(order.begin(), order.end(), 0);
+    } else {
+      order = ComputeOrdering(DependencyPattern(equations, input_vars), ordering);
+    }
+
     std::vector<CommutativePolynomial<SR>> F;
     std::vector<VarId> poly_vars;
-    for (const auto &eq : equations) {
-      poly_vars.push_back(eq.first);
-      F.push_back(eq.second);
+    for (auto i : order) {
+      poly_vars.push_back(equations[i].first);
+      F.push_back(equations[i].second);
     }
     Matrix<SR> result = solve_fixpoint(F, poly_vars, max_iter);
 
@@ -79,7 +195,8 @@ class GenericNewton {
    *  delta = DeltaGenerator.delta_at(newton_update, previous_newton_values) (generates the "rhs" of linear system) //compute delta for the next iteration
    *
    *
-   * iterate for at most max_iter iterations or until n-th iterate + abstol >= (n+1)-st iterate
+   * iterate for at most max_iter iterations or until Convergence::Converged
+   * reports that the n-th and the (n+1)-st iterate are close enough
   */
   Matrix<SR> solve_fixpoint(
       const std::vector< Poly<SR> > &polynomials,
@@ -87,42 +204,121 @@ class GenericNewton {
 
     assert(polynomials.size() == variables.size());
 
-    Matrix< Poly<SR> > F_mat{polynomials.size(), polynomials};
+    CompiledPolynomialSystem<SR> F_compiled{polynomials, variables};
 
     Matrix<SR> newton_values{polynomials.size(), 1};
     Matrix<SR> previous_newton_values{polynomials.size(), 1};
 
-    ValuationMap<SR> values;
-    for (auto &variable : variables) {
-      values.insert(std::make_pair(variable, SR::null()));
-    }
-    Matrix<SR> delta= Poly<SR>::eval(F_mat, values); //TODO: use delta_at here as well??
+    Matrix<SR> delta = F_compiled.eval(newton_values); //TODO: use delta_at here as well??
 
     Matrix<SR> newton_update{polynomials.size(), 1};
 
     LinEqSolver LinSolver = LinEqSolver(polynomials, variables);
     DeltaGenerator DeltaGen = DeltaGenerator(polynomials, variables);
 
-    for (unsigned int i=0; i < max_iter; ++i) {
+    iterations_ = 0;
+    while (iterations_ < max_iter) {
       newton_update = LinSolver.solve_lin_at(newton_values, delta, variables);
+      ++iterations_;
 
-      /* No need to recompute delta if this is the last iteration... */
-      if (!SR::IsIdempotent() && i + 1 < max_iter) {
-        delta = DeltaGen.delta_at(newton_update, newton_values);
-        //std::cout << "delta:" << std::endl << delta << std::endl;
-      }
-
+      previous_newton_values = newton_values;
       if (!SR::IsIdempotent()) {
         newton_values = newton_values + newton_update;
       } else {
         newton_values = newton_update;
       }
+
+      if (Convergence::Converged(F_compiled, previous_newton_values,
+                                 newton_values)) {
+        break;
+      }
+
+      /* No need to recompute delta if this is the last iteration... */
+      if (!SR::IsIdempotent() && iterations_ < max_iter) {
+        delta = DeltaGen.delta_at(newton_update, previous_newton_values);
+        //std::cout << "delta:" << std::endl << delta << std::endl;
+      }
     }
 
     return newton_values;
   }
+
+  private:
+    // nonzero pattern of the Jacobian: entry (i, j) iff equation i depends on
+    // the j-th variable
+    static SparsePattern DependencyPattern(const GenericEquations<Poly, SR>& equations,
+                                           const std::vector<VarId> &variables) {
+      std::unordered_map<VarId, std::size_t> index;
+      for (std::size_t i = 0; i < variables.size(); ++i) {
+        index.insert(std::make_pair(variables[i], i));
+      }
+      std::vector<std::size_t> row_begin{0};
+      std::vector<std::size_t> column_index;
+      for (const auto &eq : equations) {
+        const std::size_t begin = column_index.size();
+        for (const auto &var : eq.second.get_variables()) {
+          auto iter = index.find(var);
+          if (iter != index.end()) {
+            column_index.push_back(iter->second);
+          }
+        }
+        std::sort(column_index.begin() + begin, column_index.end());
+        row_begin.push_back(column_index.size());
+      }
+      return SparsePattern{variables.size(), variables.size(),
+                           std::move(row_begin), std::move(column_index)};
+    }
+
+    std::size_t iterations_;
 };
 
+/*
+ * The symbolic solvers evaluate the same FreeSemiring elements in every Newton
+ * step.  Over idempotent semirings the values of the variables stop changing
+ * one after the other, so recomputing only what depends on the changed ones
+ * pays off (IncrementalEvaluator).  Otherwise almost everything changes in
+ * every step, and running the compiled program straight through is cheaper
+ * (RegisterMachine).  Both evaluate the levels of the compiled DAG in parallel
+ * if SR is thread safe and there is a SolverThreadPool.
+ */
+template <typename SR>
+using SymbolicEvaluator = typename std::conditional<
+  SR::IsIdempotent(), IncrementalEvaluator<SR>, RegisterMachine<SR> >::type;
+
+/*
+ * The symbolic solvers can keep their free elements in a FreeSemiringCache.
+ * The key is the shape of the entries of the Jacobian (see
+ * CommutativePolynomial::AppendShape) with the variables given by their
+ * position in variables, appended to key.  The leaves are the variables
+ * followed by the fresh variables that make_free used for the coefficients,
+ * in the order in which the key numbers them.  Returns false if the Jacobian
+ * contains other variables (the entry cannot be cached then).
+ */
+template <typename SR>
+bool JacobianCacheKey(const std::vector< CommutativePolynomial<SR> > &entries,
+                      const std::vector<VarId> &variables,
+                      const std::unordered_map<SR, VarId, SR> &coefficient_vars,
+                      std::vector<std::uint32_t> *key, std::vector<VarId> *leaves) {
+  assert(key && leaves);
+  std::unordered_map<VarId, std::uint32_t> index;
+  for (std::size_t i = 0; i < variables.size(); ++i) {
+    index.emplace(variables[i], i);
+  }
+  std::unordered_map<SR, std::uint32_t, SR> coefficients;
+  for (const auto &entry : entries) {
+    if (!entry.AppendShape(index, &coefficients, key)) {
+      return false;
+    }
+  }
+  *leaves = variables;
+  leaves->resize(variables.size() + coefficients.size());
+  for (const auto &coefficient_code : coefficients) {
+    (*leaves)[variables.size() + coefficient_code.second - 1] =
+      coefficient_vars.at(coefficient_code.first);
+  }
+  return true;
+}
+
 /*
  * TODO: Different LinSolvers:
  * 1) Comm-case: Compute star symbolically (F-W, recursive,...), store result, eval in each call to solve_linearization_at
@@ -139,6 +335,10 @@ class CommutativeSymbolicLinSolver {
       const std::vector< CommutativePolynomial<SR> >& F,
       const std::vector<VarId>& variables) {
 
+    // the free elements are only ever evaluated in SR
+    const SemiringLaws laws{SR::IsCommutative(), SR::IsIdempotent()};
+    FreeSemiring::AssumeLaws assume_laws{laws};
+
     Matrix< CommutativePolynomial<SR> > jacobian = CommutativePolynomial<SR>::jacobian(F, variables);
 
     std::unordered_map<SR, VarId, SR> valuation_tmp;
@@ -147,7 +347,21 @@ class CommutativeSymbolicLinSolver {
 
     //std::cout << "J: " << jacobian_free << std::endl;
 
-    jacobian_star_ = new Matrix<FreeSemiring>(jacobian_free.star());
+    std::vector<std::uint32_t> key{
+      static_cast<std::uint32_t>(jacobian.getRows()),
+      static_cast<std::uint32_t>(jacobian.getColumns())};
+    std::vector<VarId> leaves;
+    const bool cacheable = FreeSemiringCache::Enabled() &&
+      JacobianCacheKey(jacobian.getElements(), variables, valuation_tmp, &key, &leaves);
+    std::vector<FreeSemiring> star;
+    if (!cacheable || !FreeSemiringCache::Load("star", key, laws, leaves, &star)) {
+      star = jacobian_free.star().getElements();
+      if (cacheable) {
+        FreeSemiringCache::Store("star", key, laws, leaves, star);
+      }
+    }
+    jacobian_star_ = new Matrix<FreeSemiring>(jacobian.getRows(), std::move(star));
+    evaluator_ = new SymbolicEvaluator<SR>(jacobian_star_->getElements());
 
     // For benchmarking only ->
     /*std::cout << "Size of Jacobian: "
@@ -172,19 +386,23 @@ class CommutativeSymbolicLinSolver {
   }
 
   virtual ~CommutativeSymbolicLinSolver(){
+    delete evaluator_;
+    evaluator_ = 0;
     delete jacobian_star_;
     jacobian_star_ = 0;
   }
 
+  // See SymbolicEvaluator for how the entries are evaluated again.
   Matrix<SR> solve_lin_at(const Matrix<SR>& values, const Matrix<SR>& rhs,
                           const std::vector<VarId>& variables) {
     UpdateValuation(variables, values, valuation_);
-    return FreeSemiringMatrixEval(*jacobian_star_, valuation_) * rhs;
+    return Matrix<SR>(jacobian_star_->getRows(), evaluator_->Eval(valuation_)) * rhs;
   }
 
 private:
   ValuationMap<SR> valuation_;
   Matrix<FreeSemiring>* jacobian_star_;
+  SymbolicEvaluator<SR>* evaluator_;
 
   void UpdateValuation(const std::vector<VarId> &variables,
                        const Matrix<SR> &newton_values,
@@ -206,38 +424,26 @@ class CommutativeConcreteLinSolver {
   CommutativeConcreteLinSolver(
       const std::vector< CommutativePolynomial<SR> >& F,
       const std::vector<VarId>& variables)
-    : jacobian_(CommutativePolynomial<SR>::jacobian(F, variables)) {}
+    : jacobian_(F, variables) {}
 
+  /* Computes J^* rhs.  Instead of computing the (dense) star of the Jacobian
+   * we solve x = J x + rhs with the sparse LDU decomposition, which only has
+   * to touch the nonzero entries of J and the fill-in. */
   Matrix<SR> solve_lin_at(const Matrix<SR>& values, const Matrix<SR>& rhs,
                           const std::vector<VarId>& variables) {
     assert(values.getColumns() == 1);
 
     assert(variables.size() == values.getRows());
-    if (valuation_.size() > 0) {
-      assert(valuation_.size() == variables.size());
-    }
+    assert(jacobian_.GetNumVariables() == variables.size());
 
-    for (std::size_t i = 0; i < variables.size(); ++i) {
-      valuation_[variables[i]] = values.At(i, 0);
-    }
-
-    std::vector<SR> result_vec;
-    for (auto &poly : jacobian_.getElements()) {
-      result_vec.emplace_back(poly.eval(valuation_));
-    }
     /*
-    std::cout << "J:" << jacobian_ << std::endl;
-    std::cout << "concrete mat:"<< std::endl << Matrix<SR>{jacobian_.getRows(), result_vec} << std::endl;
+    std::cout << "concrete mat:"<< std::endl << jacobian_.eval(values.getElements()).ToDense() << std::endl;
     */
-    return Matrix<SR>{jacobian_.getRows(), std::move(result_vec)}.star()
-           * rhs;
+    return jacobian_.solve_LDU(values.getElements(), rhs);
   }
 
   private:
-    Matrix< CommutativePolynomial<SR> > jacobian_;
-    /* We don't want to allocate the map every time, especially since the keys
-     * do not change... */
-    ValuationMap<SR> valuation_;
+    CompiledSparseJacobian<SR> jacobian_;
 };
 
 
@@ -246,65 +452,35 @@ class CommutativeDeltaGenerator {
 public:
   CommutativeDeltaGenerator(
       const std::vector< CommutativePolynomial<SR> > &ps, const std::vector<VarId> &pvs)
-      : polynomials(ps), poly_vars(pvs) {
-    index_map_.reserve(poly_vars.size());
-    for (std::size_t i = 0; i < poly_vars.size(); ++i) {
-      index_map_.emplace(poly_vars[i], i);
-      // GCC 4.7 doesn't have emplace for std::map
-      zero_valuation_.insert(std::make_pair(poly_vars[i], SR::null()));
-    }
-  }
+      : polynomials_(ps, pvs) {}
 
   Matrix<SR> delta_at(const Matrix<SR> &newton_update,
                       const Matrix<SR> &previous_newton_values) {
 
     assert(previous_newton_values.getColumns() == 1 && newton_update.getColumns() == 1);
 
-    auto num_variables = poly_vars.size();
+    auto num_variables = polynomials_.GetNumVariables();
     assert(num_variables == previous_newton_values.getRows() &&
            num_variables == newton_update.getRows());
 
-    std::vector<SR> delta_vector;
-
-    std::unordered_map<VarId, Degree> current_max_degree;
-
-    ValuationMap<SR> newton_update_map;
-
-    for (std::size_t i = 0; i < num_variables; ++i) {
-      current_valuation_[poly_vars[i]] = previous_newton_values.At(i, 0);
-      newton_update_map.insert(
-        std::make_pair(poly_vars[i], newton_update.At(i, 0)));
-    }
-
-    for (const auto &polynomial : polynomials) {
-      SR delta = SR::null();
-      Degree polynomial_max_degree = polynomial.get_degree();
+    const std::vector<SR> &previous = previous_newton_values.getElements();
+    const std::vector<SR> &update = newton_update.getElements();
 
-      current_max_degree.clear();
-      current_max_degree.insert(polynomial.GetVarDegreeMap().begin(),
-                                polynomial.GetVarDegreeMap().end());
-
-      if (polynomial_max_degree <= 1) {
-        delta = SR::null();
-      } else {
-        delta =
-          polynomial.AllNewtonDerivatives(current_valuation_, newton_update_map);
-      }
-
-      delta_vector.emplace_back(std::move(delta));
-    }
+    // the polynomials are independent, every index writes only its own entry
+    std::vector<SR> delta_vector(polynomials_.size(), SR::null());
+    ParallelFor(polynomials_.GetThreadPool(), polynomials_.size(),
+                CompiledPolynomialSystem<SR>::kMinParallelBlock,
+      [&](std::size_t i) {
+        if (polynomials_.GetDegree(i) > 1) {
+          delta_vector[i] = polynomials_.AllNewtonDerivatives(i, previous, update);
+        }
+      });
 
     return Matrix<SR>(delta_vector.size(), std::move(delta_vector));
   }
 
 private:
-  const std::vector< CommutativePolynomial<SR> > &polynomials;
-  const std::vector<VarId> &poly_vars;
-  std::unordered_map<VarId, std::size_t> index_map_;
-  /* We cache the std::map so that we can avoid reallocating it every time.  And
-   * we also make sure that we always overwrite everything before using it... */
-  ValuationMap<SR> current_valuation_;
-  ValuationMap<SR> zero_valuation_;
+  CompiledPolynomialSystem<SR> polynomials_;
 };
 
 /* Numeric linear solver -- does not invert the Jacobian (numerically instable!)
@@ -317,43 +493,31 @@ class LinSolver_CLDU {
   LinSolver_CLDU(
       const std::vector< CommutativePolynomial<SR> >& F,
       const std::vector<VarId>& variables)
-    : jacobian_(CommutativePolynomial<SR>::jacobian(F, variables)) {}
+    : jacobian_(F, variables) {}
 
   Matrix<SR> solve_lin_at(const Matrix<SR>& values, const Matrix<SR>& rhs,
                           const std::vector<VarId>& variables) {
     assert(values.getColumns() == 1);
 
     assert(variables.size() == values.getRows());
-    if (valuation_.size() > 0) {
-      assert(valuation_.size() == variables.size());
-    }
-
-    for (std::size_t i = 0; i < variables.size(); ++i) {
-      valuation_[variables[i]] = values.At(i, 0);
-    }
-
-    std::vector<SR> result_vec;
-    for (auto &poly : jacobian_.getElements()) {
-      result_vec.emplace_back(poly.eval(valuation_));
-    }
+    assert(jacobian_.GetNumVariables() == variables.size());
 
     /*
-        std::cout << "J:" << jacobian_ << std::endl;
-        std::cout << "concrete mat:"<< std::endl << Matrix<SR>{jacobian_.getRows(), result_vec} << std::endl;
+        std::cout << "concrete mat:"<< std::endl << jacobian_.eval(values.getElements()).ToDense() << std::endl;
         */
-    return Matrix<SR>{jacobian_.getRows(), std::move(result_vec)}.solve_LDU(rhs);
+    return jacobian_.solve_LDU(values.getElements(), rhs);
   }
 
   private:
-    Matrix< CommutativePolynomial<SR> > jacobian_;
-    /* We don't want to allocate the map every time, especially since the keys
-     * do not change... */
-    ValuationMap<SR> valuation_;
+    CompiledSparseJacobian<SR> jacobian_;
 };
 
 
 // Symbolic LDU solver, compute a symbolic LDU decomposition at initialization
 // then evaluate the symbolic LDU matrix at each call
+// The decomposition is sparse: a symbolic analysis computes the nonzero pattern
+// of the factors (including the fill-in) and free semiring elements are only
+// created for these positions.
 template <typename SR>
 class LinSolver_SLDU {
   public:
@@ -362,19 +526,57 @@ class LinSolver_SLDU {
       const std::vector< CommutativePolynomial<SR> >& F,
       const std::vector<VarId>& variables) {
 
-    Matrix< CommutativePolynomial<SR> > jacobian = CommutativePolynomial<SR>::jacobian(F, variables);
+    // the free elements are only ever evaluated in SR
+    const SemiringLaws laws{SR::IsCommutative(), SR::IsIdempotent()};
+    FreeSemiring::AssumeLaws assume_laws{laws};
+
+    SparseMatrix< CommutativePolynomial<SR> > jacobian =
+      CommutativePolynomial<SR>::sparse_jacobian(F, variables);
     std::unordered_map<SR, VarId, SR> valuation_tmp;
-    Matrix<FreeSemiring> jacobian_free = CommutativePolynomial<SR>::make_free(jacobian, &valuation_tmp);
+    std::vector<FreeSemiring> jacobian_free;
+    jacobian_free.reserve(jacobian.getValues().size());
+    for (const auto &polynomial : jacobian.getValues()) {
+      jacobian_free.emplace_back(polynomial.make_free(&valuation_tmp));
+    }
 
     //std::cout << "J: " << jacobian_free << std::endl;
-    Matrix<FreeSemiring>::LDU_decomposition_2(jacobian_free);
 
-    jacobian_ldu_ = new Matrix<FreeSemiring>(jacobian_free);
+    // the pattern of the factors only depends on the pattern of the Jacobian
+    const SparsePattern &pattern = jacobian.getPattern();
+    std::vector<std::uint32_t> key{
+      static_cast<std::uint32_t>(pattern.getRows()),
+      static_cast<std::uint32_t>(pattern.getColumns()),
+      static_cast<std::uint32_t>(pattern.getNonZeros())};
+    for (std::size_t r = 0; r < pattern.getRows(); ++r) {
+      key.push_back(pattern.RowBegin(r));
+    }
+    for (std::size_t p = 0; p < pattern.getNonZeros(); ++p) {
+      key.push_back(pattern.Column(p));
+    }
+    std::vector<VarId> leaves;
+    const bool cacheable = FreeSemiringCache::Enabled() &&
+      JacobianCacheKey(jacobian.getValues(), variables, valuation_tmp, &key, &leaves);
+    std::vector<FreeSemiring> ldu;
+    if (cacheable && FreeSemiringCache::Load("ldu", key, laws, leaves, &ldu)) {
+      jacobian_ldu_ = new SparseMatrix<FreeSemiring>(pattern.LDU_pattern(), std::move(ldu));
+    } else {
+      jacobian_ldu_ = new SparseMatrix<FreeSemiring>(
+        SparseMatrix<FreeSemiring>::LDU_decomposition(
+          SparseMatrix<FreeSemiring>{jacobian.getPatternPtr(), std::move(jacobian_free)},
+          pattern.LDU_pattern()));
+      if (cacheable) {
+        FreeSemiringCache::Store("ldu", key, laws, leaves, jacobian_ldu_->getValues());
+      }
+    }
+    evaluator_ = new SymbolicEvaluator<SR>(jacobian_ldu_->getValues());
+
     // For benchmarking only ->
     /*std::cout << "Size of Jacobian: "
-              << jacobian_star_->getRows()
+              << jacobian_ldu_->getRows()
               << " x "
-              << jacobian_star_->getColumns()
+              << jacobian_ldu_->getColumns()
+              << ", nonzeros: " << jacobian.getPattern().getNonZeros()
+              << ", with fill-in: " << jacobian_ldu_->getPattern().getNonZeros()
               << std::endl;*/
     //FreeSemiring::one().PrintStats();
 
@@ -384,7 +586,7 @@ class LinSolver_SLDU {
     FreeSemiring::one().PrintDot(dotfile);
     dotfile.close();*/
 
-    //std::cout << "J(ldu): " << *jacobian_ldu_ << std::endl;
+    //std::cout << "J(ldu): " << jacobian_ldu_->ToDense() << std::endl;
 
     for (auto &pair : valuation_tmp) {
       valuation_.insert(std::make_pair(pair.second, pair.first));
@@ -393,6 +595,8 @@ class LinSolver_SLDU {
   }
 
   virtual ~LinSolver_SLDU(){
+    delete evaluator_;
+    evaluator_ = 0;
     delete jacobian_ldu_;
     jacobian_ldu_ = 0;
   }
@@ -400,13 +604,14 @@ class LinSolver_SLDU {
   Matrix<SR> solve_lin_at(const Matrix<SR>& values, const Matrix<SR>& rhs,
                           const std::vector<VarId>& variables) {
     UpdateValuation(variables, values, valuation_);
-    Matrix<SR> b = rhs;
-    return Matrix<SR>::subst_LDU(FreeSemiringMatrixEval(*jacobian_ldu_, valuation_), b);
+    return SparseMatrix<SR>::subst_LDU(
+        SparseMatrix<SR>(jacobian_ldu_->getPatternPtr(), evaluator_->Eval(valuation_)), rhs);
   }
 
   private:
     ValuationMap<SR> valuation_;
-    Matrix<FreeSemiring>* jacobian_ldu_;
+    SparseMatrix<FreeSemiring>* jacobian_ldu_;
+    SymbolicEvaluator<SR>* evaluator_;
 
     void UpdateValuation(const std::vector<VarId> &variables,
                          const Matrix<SR> &newton_values,
@@ -429,7 +634,7 @@ class DeltaGenerator_Numeric {
 public:
   DeltaGenerator_Numeric(
       const std::vector< CommutativePolynomial<SR> > &ps, const std::vector<VarId> &pvs)
-      : polynomials(ps), poly_vars(pvs) {
+      : polynomials_(ps, pvs) {
 
   }
 
@@ -438,33 +643,29 @@ public:
                       const Matrix<SR> &previous_newton_values) {
 
     Matrix<SR> current_newton_values = previous_newton_values + newton_update;
-
-    for (std::size_t i = 0; i < poly_vars.size(); ++i) {
-      current_valuation_[poly_vars[i]] = current_newton_values.At(i, 0);
-    }
-
-    std::vector<SR> result_vec;
-    for (int i =0; i<polynomials.size(); ++i) {
-      if(SR::isInf(current_newton_values.At(i,0)))
-        result_vec.emplace_back(current_newton_values.At(i,0));
-      else
-        result_vec.emplace_back(polynomials[i].eval(current_valuation_) - current_newton_values.At(i,0));
-    }
-
-    return Matrix<SR>(poly_vars.size(),std::move(result_vec));
+    const std::vector<SR> &current = current_newton_values.getElements();
+
+    std::vector<SR> result_vec(polynomials_.size(), SR::null());
+    ParallelFor(polynomials_.GetThreadPool(), polynomials_.size(),
+                CompiledPolynomialSystem<SR>::kMinParallelBlock,
+      [&](std::size_t i) {
+        if(SR::isInf(current[i]))
+          result_vec[i] = current[i];
+        else
+          result_vec[i] = polynomials_.eval(i, current) - current[i];
+      });
+
+    return Matrix<SR>(polynomials_.size(),std::move(result_vec));
   }
 private:
-  const std::vector< CommutativePolynomial<SR> > &polynomials;
-  const std::vector<VarId> &poly_vars;
-  /* We cache the std::map so that we can avoid reallocating it every time.  And
-   * we also make sure that we always overwrite everything before using it... */
-  ValuationMap<SR> current_valuation_;
+  CompiledPolynomialSystem<SR> polynomials_;
 };
 
 /*
  * TODO: other signature for "solving" linsys ?? (with number of iterations?)
  * Be sure to call it only on semirings for which the iteration terminates...
- * TODO: implement round-robin iteration etc. (all the tricks from program-analysis.. see Tarjan's paper from '76)
+ * TODO: implement round-robin iteration etc. (all the tricks from program-analysis.. see Tarjan's paper from '76),
+ *       as ChaoticIteration (chaotic_iteration.h) does for commutative systems
  */
 template <typename SR>
 class SimpleKleeneLinSolver {
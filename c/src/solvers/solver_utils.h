@@ -12,8 +12,21 @@
 #include <boost/graph/strong_components.hpp>
 #include <boost/graph/graphviz.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
 #include "../datastructs/equations.h"
 
+#include "../semirings/semiring.h"
+
+#include "../utils/thread_pool.h"
 #include "../utils/timer.h"
 
 
@@ -88,19 +101,246 @@ group_by_scc(const GenericEquations<Poly, SR> &equations,
   return grouped_equations;
 }
 
+// for every SCC (as returned by group_by_scc) compute the indices of the SCCs
+// whose solutions are needed to solve it, i.e., its successors in the
+// condensation DAG.
+template <typename SR, template <typename> class Poly>
+std::vector< std::vector<std::size_t> >
+scc_dependencies(const std::vector< GenericEquations<Poly, SR> > &sccs) {
+  std::unordered_map<VarId, std::size_t> var_scc;
+  for (std::size_t j = 0; j < sccs.size(); ++j) {
+    for (const auto &eq : sccs[j]) {
+      var_scc[eq.first] = j;
+    }
+  }
+
+  std::vector< std::vector<std::size_t> > dependencies(sccs.size());
+  for (std::size_t j = 0; j < sccs.size(); ++j) {
+    std::set<std::size_t> deps;
+    for (const auto &eq : sccs[j]) {
+      for (const auto &var : eq.second.get_variables()) {
+        auto iter = var_scc.find(var);
+        if (iter != var_scc.end() && iter->second != j) {
+          deps.insert(iter->second);
+        }
+      }
+    }
+    dependencies[j].assign(deps.begin(), deps.end());
+  }
+  return dependencies;
+}
+
+// Many systems contain SCCs that are equal up to renaming their variables
+// (e.g., the nonterminals for lists or options of different symbols).  Once the
+// solutions of the SCCs they depend on have been substituted, the solutions of
+// such SCCs are equal up to the same renaming, so only the first one is solved.
+//
+// An SCC is compared in a canonical form, where its variables are renamed to
+// placeholders.  The variables are numbered in the order of the equations,
+// stably sorted by the shape of their polynomials (with all the variables of
+// the SCC renamed to the same placeholder), so that most isomorphic SCCs get
+// the same canonical form even if their equations are given in another order.
+// Canonical forms are only considered equal if their equations are, so a
+// solution is never reused for an SCC that is not isomorphic.
+template <typename SR, template <typename> class Poly>
+class SccSolutionCache {
+  public:
+    struct CanonicalForm {
+      std::vector<VarId> variables;  // the variable renamed to the i-th placeholder
+      GenericEquations<Poly, SR> equations;
+      std::string key;
+    };
+
+    static CanonicalForm Canonicalize(const GenericEquations<Poly, SR> &equations) {
+      SubstitutionMap to_any;
+      for (const auto &eq : equations) {
+        to_any.emplace(eq.first, Placeholder());
+      }
+      std::vector< std::pair<std::string, std::size_t> > shapes;
+      for (std::size_t i = 0; i < equations.size(); ++i) {
+        shapes.emplace_back(Poly<SR>{equations[i].second.subst(to_any)}.string(), i);
+      }
+      std::sort(shapes.begin(), shapes.end());
+
+      CanonicalForm canonical;
+      SubstitutionMap renaming;
+      for (std::size_t i = 0; i < shapes.size(); ++i) {
+        canonical.variables.push_back(equations[shapes[i].second].first);
+        renaming.emplace(canonical.variables.back(), Placeholder(i));
+      }
+      std::stringstream key;
+      for (std::size_t i = 0; i < shapes.size(); ++i) {
+        canonical.equations.emplace_back(
+            Placeholder(i), Poly<SR>{equations[shapes[i].second].second.subst(renaming)});
+        key << canonical.equations.back().second.string() << ";";
+      }
+      canonical.key = key.str();
+      return canonical;
+    }
+
+    // If an SCC with the same canonical form has been solved, stores its
+    // solution (for the variables of canonical) in solution and returns true.
+    bool Find(const CanonicalForm &canonical, ValuationMap<SR> *solution) {
+      assert(solution);
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto range = entries_.equal_range(canonical.key);
+      for (auto iter = range.first; iter != range.second; ++iter) {
+        if (iter->second.first == canonical.equations) {
+          for (std::size_t i = 0; i < canonical.variables.size(); ++i) {
+            solution->emplace(canonical.variables[i], iter->second.second[i]);
+          }
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void Insert(const CanonicalForm &canonical, const ValuationMap<SR> &solution) {
+      std::vector<SR> values;
+      for (auto var : canonical.variables) {
+        auto iter = solution.find(var);
+        if (iter == solution.end()) {
+          return;
+        }
+        values.push_back(iter->second);
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      entries_.emplace(canonical.key, std::make_pair(canonical.equations, std::move(values)));
+    }
+
+  private:
+    static VarId Placeholder() { return Var::GetVarId("_scc"); }
+
+    static VarId Placeholder(std::size_t i) {
+      return Var::GetVarId("_scc" + std::to_string(i));
+    }
+
+    std::mutex mutex_;
+    std::unordered_multimap< std::string,
+      std::pair< GenericEquations<Poly, SR>, std::vector<SR> > > entries_;
+};
+
+// use the given solutions to get rid of variables in the equations and solve
+// the remaining system (unless cache has the solution of an isomorphic one)
+template <template <typename> class SolverType,
+          template <typename> class Poly,
+          typename SR>
+ValuationMap<SR> solve_scc(
+    const GenericEquations<Poly, SR> &equations, const ValuationMap<SR> &solution,
+    bool iteration_flag, std::size_t iterations, std::mutex *output_mutex,
+    SccSolutionCache<SR, Poly> *cache = nullptr) {
+
+  GenericEquations<Poly, SR> simplified;
+  for (auto it = equations.begin(); it != equations.end(); ++it)
+  { // it = (VarId, Polynomial[SR])
+    simplified.push_back(std::pair<VarId, Poly<SR>>(it->first, it->second.partial_eval(solution)));
+  }
+
+  typename SccSolutionCache<SR, Poly>::CanonicalForm canonical;
+  if (cache) {
+    canonical = SccSolutionCache<SR, Poly>::Canonicalize(simplified);
+    ValuationMap<SR> result;
+    if (cache->Find(canonical, &result)) {
+      return result;
+    }
+  }
+
+  // dynamic iterations
+  if (!iteration_flag) {
+    // for commutative and idempotent SRs Newton has converged after n+1 iterations, so use this number as default
+    iterations = simplified.size() + 1;
+  }
+
+  // do some real work here
+  SolverType<SR> solver;
+  ValuationMap<SR> result = solver.solve_fixpoint(simplified, iterations);
+
+  // the solver may stop as soon as the iteration has converged
+  if (output_mutex) {
+    std::lock_guard<std::mutex> lock(*output_mutex);
+    std::cout << "Iterations: " << solver.GetIterations()
+              << " (max. " << iterations << ")" << std::endl;
+  } else {
+    std::cout << "Iterations: " << solver.GetIterations()
+              << " (max. " << iterations << ")" << std::endl;
+  }
+
+  if (cache) {
+    cache->Insert(canonical, result);
+  }
+  return result;
+}
+
+// solve the SCCs on a thread pool: every SCC is started as soon as all the SCCs
+// it depends on have been solved
+template <template <typename> class SolverType,
+          template <typename> class Poly,
+          typename SR>
+ValuationMap<SR> solve_sccs_parallel(
+    const std::vector< GenericEquations<Poly, SR> > &sccs,
+    bool iteration_flag, std::size_t iterations, ThreadPool &pool,
+    SccSolutionCache<SR, Poly> *cache) {
+
+  const auto dependencies = scc_dependencies(sccs);
+
+  std::vector< std::vector<std::size_t> > dependents(sccs.size());
+  std::unique_ptr< std::atomic<std::size_t>[] > missing{
+    new std::atomic<std::size_t>[sccs.size()]};
+  for (std::size_t j = 0; j < sccs.size(); ++j) {
+    missing[j] = dependencies[j].size();
+    for (auto dep : dependencies[j]) {
+      dependents[dep].push_back(j);
+    }
+  }
+
+  // every SCC writes only its own entry, the entries of its dependencies are
+  // complete before it is started
+  std::vector< ValuationMap<SR> > results(sccs.size());
+  std::mutex output_mutex;
+
+  TaskGroup group{pool};
+
+  std::function<void(std::size_t)> schedule = [&](std::size_t j) {
+    group.Run([&, j]() {
+      ValuationMap<SR> solution;
+      for (auto dep : dependencies[j]) {
+        solution.insert(results[dep].begin(), results[dep].end());
+      }
+      results[j] = solve_scc<SolverType>(sccs[j], solution, iteration_flag,
+                                         iterations, &output_mutex, cache);
+      for (auto succ : dependents[j]) {
+        if (--missing[succ] == 0) {
+          schedule(succ);
+        }
+      }
+    });
+  };
+
+  for (std::size_t j = 0; j < sccs.size(); ++j) {
+    if (dependencies[j].empty()) {
+      schedule(j);
+    }
+  }
+  group.Wait();
+
+  ValuationMap<SR> solution;
+  for (const auto &result : results) {
+    solution.insert(result.begin(), result.end());
+  }
+  return solution;
+}
+
 // apply solving method to the given input
 template <template <typename> class SolverType,
           template <typename> class Poly,
           typename SR>
 ValuationMap<SR> apply_solver(
     const GenericEquations<Poly, SR> &equations,
-    bool scc, bool iteration_flag, std::size_t iterations, bool graphviz_output) {
+    bool scc, bool iteration_flag, std::size_t iterations, bool graphviz_output,
+    std::size_t threads = 1) {
 
   // TODO: sanity checks on the input!
 
-  // generate an instance of the solver
-  SolverType<SR> solver;
-
   // if we use the scc method, group the equations
   // the outer vector contains SCCs starting with a bottom SCC at 0
   std::vector<GenericEquations<Poly, SR>> equations2;
@@ -112,40 +352,44 @@ ValuationMap<SR> apply_solver(
     equations2.push_back(equations);
   }
 
+  if (threads > 1 && !IsThreadSafe<SR>::value) {
+    std::cout << "Semiring does not support multiple threads, solving sequentially." << std::endl;
+    threads = 1;
+  }
+
+  // the same pool is used for independent SCCs and for the data parallel
+  // loops inside of the solvers (a waiting thread only helps with the tasks of
+  // its own TaskGroup, so a loop never ends up solving an unrelated SCC on its
+  // stack, and it sleeps once those tasks are all taken)
+  std::unique_ptr<ThreadPool> pool;
+  if (threads > 1) {
+    pool.reset(new ThreadPool{threads});
+  }
+  SolverThreadPoolScope pool_scope{pool.get()};
+
   // this holds the solution
   ValuationMap<SR> solution;
 
+  // isomorphic SCCs are only solved once
+  SccSolutionCache<SR, Poly> cache;
+
   Timer timer;
   timer.Start();
 
-  // the same loop is used for both the scc and the non-scc variant
-  // in the non-scc variant, we just run once through the loop
-  //for (auto it1 = equations2.begin(); it != equations2.end(); ++it)
-  for (std::size_t j = 0; j != equations2.size(); ++j) {
-    // use the solutions to get rid of variables in the remaining equations
-    // does nothing in the first round
-    GenericEquations<Poly, SR> tmp1;
-    for (auto it = equations2[j].begin(); it != equations2[j].end(); ++it)
-    { // it = (VarId, Polynomial[SR])
-      auto tmp2 = it->second.partial_eval(solution);
-      tmp1.push_back(std::pair<VarId, Poly<SR>>(it->first, tmp2));
-    }
-    // replace old equations with simplified ones
-    equations2[j] = tmp1;
+  if (pool && equations2.size() > 1) {
+    solution = solve_sccs_parallel<SolverType>(equations2, iteration_flag,
+                                               iterations, *pool, &cache);
+  } else {
+    // the same loop is used for both the scc and the non-scc variant
+    // in the non-scc variant, we just run once through the loop
+    for (std::size_t j = 0; j != equations2.size(); ++j) {
+      ValuationMap<SR> result = solve_scc<SolverType>(
+          equations2[j], solution, iteration_flag, iterations, nullptr,
+          equations2.size() > 1 ? &cache : nullptr);
 
-    // dynamic iterations
-    if (!iteration_flag) {
-      // for commutative and idempotent SRs Newton has converged after n+1 iterations, so use this number as default
-      iterations = equations2[j].size() + 1;
+      // copy the results into the solution map
+      solution.insert(result.begin(), result.end());
     }
-
-    std::cout << "Iterations: " << iterations << std::endl;
-
-    // do some real work here
-    ValuationMap<SR> result = solver.solve_fixpoint(equations2[j], iterations);
-
-    // copy the results into the solution map
-    solution.insert(result.begin(), result.end());
   }
 
   timer.Stop();
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * ThreadPool
+ *
+ * A small work-stealing thread pool.  Every worker owns a deque of tasks: it
+ * pushes and pops its own tasks at the back and steals from the front of the
+ * other deques when it runs out of work.  Tasks submitted from outside of the
+ * pool go to an extra "external" deque that everybody steals from.
+ *
+ * A pool of size n starts only n-1 worker threads, since the thread that waits
+ * for the tasks (see TaskGroup::Wait) is expected to help executing them.  So
+ * a pool of size 1 does not start any thread at all and simply runs everything
+ * on the waiting thread.  Tasks are only submitted directly by TaskGroup.
+ */
+class ThreadPool {
+  typedef std::function<void()> Task;
+
+  public:
+    explicit ThreadPool(std::size_t num_threads)
+        : num_threads_(std::max<std::size_t>(num_threads, 1)),
+          queues_(num_threads_), pending_(0), done_(false) {
+      for (std::size_t i = 0; i < num_threads_; ++i) {
+        queues_[i].reset(new TaskQueue);
+      }
+      /* The last queue is reserved for tasks submitted by non-worker threads. */
+      for (std::size_t i = 0; i + 1 < num_threads_; ++i) {
+        workers_.emplace_back([this, i]() { WorkerLoop(i); });
+      }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool& operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        done_ = true;
+      }
+      sleep_cv_.notify_all();
+      for (auto &worker : workers_) {
+        worker.join();
+      }
+    }
+
+    std::size_t GetNumThreads() const { return num_threads_; }
+
+    void Submit(Task task) {
+      {
+        /* Taking the lock makes sure that no worker misses the wake-up between
+         * checking pending_ and going to sleep.  The counter is incremented
+         * before the task becomes visible so that it never underflows. */
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        ++pending_;
+      }
+      auto &queue = *queues_[CurrentQueueIndex()];
+      {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+      }
+      sleep_cv_.notify_one();
+    }
+
+  private:
+    struct TaskQueue {
+      std::mutex mutex;
+      std::deque<Task> tasks;
+    };
+
+    /* Index of the queue owned by the calling thread.  Threads that do not
+     * belong to this pool share the last queue. */
+    std::size_t CurrentQueueIndex() const {
+      if (CurrentPool() == this) {
+        return CurrentWorker();
+      }
+      return num_threads_ - 1;
+    }
+
+    bool PopTask(std::size_t own, Task &task) {
+      {
+        auto &queue = *queues_[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+          task = std::move(queue.tasks.back());
+          queue.tasks.pop_back();
+          --pending_;
+          return true;
+        }
+      }
+      for (std::size_t k = 1; k < num_threads_; ++k) {
+        auto &victim = *queues_[(own + k) % num_threads_];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+          task = std::move(victim.tasks.front());
+          victim.tasks.pop_front();
+          --pending_;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void WorkerLoop(std::size_t index) {
+      CurrentPool() = this;
+      CurrentWorker() = index;
+      while (true) {
+        Task task;
+        if (PopTask(index, task)) {
+          task();
+          continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleep_cv_.wait(lock, [this]() { return done_ || pending_ > 0; });
+        if (done_) {
+          return;
+        }
+      }
+    }
+
+    static const ThreadPool*& CurrentPool() {
+      static thread_local const ThreadPool *pool = nullptr;
+      return pool;
+    }
+
+    static std::size_t& CurrentWorker() {
+      static thread_local std::size_t worker = 0;
+      return worker;
+    }
+
+    const std::size_t num_threads_;
+    std::vector< std::unique_ptr<TaskQueue> > queues_;
+    std::vector<std::thread> workers_;
+
+    std::atomic<std::size_t> pending_;
+    bool done_;
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+};
+
+
+/*
+ * TaskGroup
+ *
+ * Keeps track of a set of tasks executed on a ThreadPool.  Tasks of a group
+ * can spawn further tasks of the same group.  Wait() lets the calling thread
+ * execute the pending tasks of this group (but never the ones of other groups,
+ * so waiting inside of a task does not pull unrelated work onto its stack),
+ * and once they are all taken, sleeps until the ones running on other threads
+ * are finished.  This way it is also safe to wait for a TaskGroup from inside
+ * of a task that runs on the pool.
+ *
+ * The tasks are kept in a queue of the group, the pool only gets a ticket for
+ * every task that runs the oldest task of the group that is still pending (if
+ * the waiting thread has not taken them all already).  A pool without worker
+ * threads gets no tickets at all.
+ */
+class TaskGroup {
+  typedef std::function<void()> Task;
+
+  public:
+    explicit TaskGroup(ThreadPool &pool) : pool_(pool), state_(std::make_shared<State>()) {}
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup& operator=(const TaskGroup &) = delete;
+
+    ~TaskGroup() { Wait(); }
+
+    void Run(Task task) {
+      {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        ++state_->running;
+        state_->tasks.push_back(std::move(task));
+      }
+      state_->cv.notify_all();
+      if (pool_.GetNumThreads() > 1) {
+        // the ticket keeps the state alive, the group may be gone by the time
+        // it runs
+        std::shared_ptr<State> state = state_;
+        pool_.Submit([state]() {
+          Task task;
+          {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->tasks.empty()) {
+              return;
+            }
+            task = std::move(state->tasks.front());
+            state->tasks.pop_front();
+          }
+          Execute(*state, task);
+        });
+      }
+    }
+
+    void Wait() {
+      while (true) {
+        Task task;
+        {
+          std::unique_lock<std::mutex> lock(state_->mutex);
+          state_->cv.wait(lock, [this]() {
+            return state_->running == 0 || !state_->tasks.empty();
+          });
+          if (state_->tasks.empty()) {
+            return;
+          }
+          task = std::move(state_->tasks.back());
+          state_->tasks.pop_back();
+        }
+        Execute(*state_, task);
+      }
+    }
+
+  private:
+    struct State {
+      std::mutex mutex;
+      std::condition_variable cv;
+      // tasks that have not been started yet
+      std::deque<Task> tasks;
+      // tasks that have not finished yet (including the pending ones)
+      std::size_t running = 0;
+    };
+
+    static void Execute(State &state, const Task &task) {
+      task();
+      bool finished;
+      {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        finished = --state.running == 0;
+      }
+      if (finished) {
+        state.cv.notify_all();
+      }
+    }
+
+    ThreadPool &pool_;
+    std::shared_ptr<State> state_;
+};
+
+
+/*
+ * The pool used for the data parallel loops inside of the solvers (e.g., the
+ * evaluation of the Jacobian in every Newton iteration).  It is installed by
+ * apply_solver for the time of solving with SolverThreadPoolScope, nullptr
+ * means that everything runs sequentially.
+ */
+inline ThreadPool*& SolverThreadPool() {
+  static ThreadPool *pool = nullptr;
+  return pool;
+}
+
+class SolverThreadPoolScope {
+  public:
+    explicit SolverThreadPoolScope(ThreadPool *pool) : previous_(SolverThreadPool()) {
+      SolverThreadPool() = pool;
+    }
+
+    SolverThreadPoolScope(const SolverThreadPoolScope &) = delete;
+    SolverThreadPoolScope& operator=(const SolverThreadPoolScope &) = delete;
+
+    ~SolverThreadPoolScope() { SolverThreadPool() = previous_; }
+
+  private:
+    ThreadPool *previous_;
+};
+
+
+/*
+ * Calls body(i) for every i in [0, n).  The range is split into contiguous
+ * blocks of at least min_block indices that are executed on the pool (if
+ * there is one), the calling thread helps until all blocks are done.  The
+ * body must only write data that belongs to index i, then the result does not
+ * depend on the number of threads.
+ */
+template <typename Body>
+void ParallelFor(ThreadPool *pool, std::size_t n, std::size_t min_block,
+                 const Body &body) {
+  const std::size_t threads = pool ? pool->GetNumThreads() : 1;
+  if (threads == 1 || n <= min_block) {
+    for (std::size_t i = 0; i < n; ++i) {
+      body(i);
+    }
+    return;
+  }
+
+  /* A few blocks per thread balance the load if the indices differ in cost. */
+  const std::size_t num_blocks =
+    std::min(4 * threads, (n + min_block - 1) / min_block);
+  const std::size_t block_size = (n + num_blocks - 1) / num_blocks;
+
+  TaskGroup group{*pool};
+  for (std::size_t begin = block_size; begin < n; begin += block_size) {
+    const std::size_t end = std::min(begin + block_size, n);
+    group.Run([&body, begin, end]() {
+      for (std::size_t i = begin; i < end; ++i) {
+        body(i);
+      }
+    });
+  }
+  for (std::size_t i = 0; i < block_size; ++i) {
+    body(i);
+  }
+  group.Wait();
+}
@@ -1,6 +1,17 @@
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include <dirent.h>
+#include <unistd.h>
+
 #include "test-free-semiring.h"
 #include "util.h"
 
+#include "../src/datastructs/arena.h"
+#include "../src/semirings/float-semiring.h"
+#include "../src/semirings/free-semiring-cache.h"
+
 CPPUNIT_TEST_SUITE_REGISTRATION(FreeSemiringTest);
 
 void FreeSemiringTest::setUp()
@@ -59,3 +70,345 @@ void FreeSemiringTest::testStar()
         // corresponding constructor...
 	// CPPUNIT_ASSERT( a->star() == FreeSemiring(FreeSemiring::Star, *a));
 }
+
+void FreeSemiringTest::testSimplification()
+{
+	const FreeSemiring zero = FreeSemiring::null();
+	const FreeSemiring one = FreeSemiring::one();
+	FreeSemiring a_star = a->star();
+
+	// the laws of every semiring
+	CPPUNIT_ASSERT( zero + (*a) == (*a) && (*a) + zero == (*a) );
+	CPPUNIT_ASSERT( one * (*a) == (*a) && (*a) * one == (*a) );
+	CPPUNIT_ASSERT( zero * (*a) == zero && (*a) * zero == zero );
+
+	// but nothing else by default
+	CPPUNIT_ASSERT( !((*a) * (*b) == (*b) * (*a)) );
+	CPPUNIT_ASSERT( !((*a) + (*a) == (*a)) );
+	CPPUNIT_ASSERT( !(a_star.star() == a_star) );
+
+	{
+		FreeSemiring::AssumeLaws laws{SemiringLaws{true, false}};
+		CPPUNIT_ASSERT( (*a) * (*b) == (*b) * (*a) );
+		CPPUNIT_ASSERT( !((*a) + (*a) == (*a)) );
+	}
+
+	{
+		FreeSemiring::AssumeLaws laws{SemiringLaws{false, true}};
+		CPPUNIT_ASSERT( !((*a) * (*b) == (*b) * (*a)) );
+		CPPUNIT_ASSERT( (*a) + (*a) == (*a) );
+		CPPUNIT_ASSERT( (*a) + a_star == a_star && a_star + (*a) == a_star );
+		CPPUNIT_ASSERT( one + a_star == a_star );
+		CPPUNIT_ASSERT( a_star * a_star == a_star );
+		CPPUNIT_ASSERT( a_star.star() == a_star );
+		CPPUNIT_ASSERT( one.star() == one );
+		CPPUNIT_ASSERT( ((*a) + one).star() == a_star );
+		CPPUNIT_ASSERT( (one + (one + (*a))).star() == a_star );
+	}
+
+	// only while the laws are assumed
+	CPPUNIT_ASSERT( !((*a) + (*a) == (*a)) );
+}
+
+void FreeSemiringTest::testCompiledDag()
+{
+	// a*b + b*a, a*b
+	std::vector<FreeSemiring> elements = { (*a) * (*b) + (*b) * (*a), (*a) * (*b) };
+	CompiledDag dag = FreeSemiring::Compile(elements);
+	// a, b, a*b, b*a, +
+	CPPUNIT_ASSERT( dag.size() == 5 );
+	CPPUNIT_ASSERT( dag.GetElements().size() == 2 );
+	CPPUNIT_ASSERT( dag.GetRoots().size() == 2 );
+	CPPUNIT_ASSERT( dag[dag.GetRoots()[0]].op == CompiledDag::Op::Addition );
+	CPPUNIT_ASSERT( dag[dag.GetRoots()[1]].op == CompiledDag::Op::Multiplication );
+	// the leaves, the products and the sum
+	CPPUNIT_ASSERT( dag.GetNumLevels() == 3 );
+	for (std::size_t l = 0; l < dag.GetNumLevels(); ++l) {
+		for (std::size_t i = dag.LevelBegin(l); i < dag.LevelEnd(l); ++i) {
+			if (dag[i].op == CompiledDag::Op::Addition || dag[i].op == CompiledDag::Op::Multiplication) {
+				CPPUNIT_ASSERT( dag[i].lhs < dag.LevelBegin(l) && dag[i].rhs < dag.LevelBegin(l) );
+			}
+		}
+	}
+
+	// deep enough to overflow the stack of a recursive evaluation:
+	// x_0 = a, x_{i+1} = x_i b + c
+	FreeSemiring x = *a;
+	for (int i = 0; i < 200000; ++i) {
+		x = x * (*b) + (*c);
+	}
+	ValuationMap<FloatSemiring> valuation = {
+		{ Var::GetVarId("a"), FloatSemiring(1) },
+		{ Var::GetVarId("b"), FloatSemiring(0.5) },
+		{ Var::GetVarId("c"), FloatSemiring(0.5) } };
+	CPPUNIT_ASSERT( x.Eval(valuation) == FloatSemiring(1) );
+	DagEvaluator<FloatSemiring> evaluator{dag};
+	std::vector<FloatSemiring> result = evaluator.Eval(valuation);
+	CPPUNIT_ASSERT( result[0] == FloatSemiring(1) );
+	CPPUNIT_ASSERT( result[1] == FloatSemiring(0.5) );
+}
+
+void FreeSemiringTest::testParallelDagEvaluator()
+{
+	// sum_i (x_i y_i)* + x_i, wide enough to split the levels
+	std::vector<FreeSemiring> elements;
+	ValuationMap<FloatSemiring> valuation;
+	FreeSemiring sum = FreeSemiring::null();
+	for (int i = 0; i < 1000; ++i) {
+		VarId x = Var::GetVarId("par_x" + std::to_string(i));
+		VarId y = Var::GetVarId("par_y" + std::to_string(i));
+		valuation[x] = FloatSemiring(0.001 * i);
+		valuation[y] = FloatSemiring(0.5);
+		elements.push_back((FreeSemiring(x) * FreeSemiring(y)).star() + FreeSemiring(x));
+		sum += elements.back();
+	}
+	elements.push_back(sum);
+	CompiledDag dag = FreeSemiring::Compile(elements);
+
+	DagEvaluator<FloatSemiring> sequential{dag};
+	std::vector<FloatSemiring> expected = sequential.Eval(valuation);
+
+	ThreadPool pool{4};
+	SolverThreadPoolScope pool_scope{&pool};
+	DagEvaluator<FloatSemiring> parallel{dag};
+	CPPUNIT_ASSERT( parallel.Eval(valuation) == expected );
+	CPPUNIT_ASSERT( parallel.Eval(valuation) == expected );
+}
+
+void FreeSemiringTest::testIncrementalEvaluator()
+{
+	// a*b, (a + c)*, b*c
+	std::vector<FreeSemiring> elements = { (*a) * (*b), ((*a) + (*c)).star(), (*b) * (*c) };
+	IncrementalEvaluator<FloatSemiring> evaluator{elements};
+	CPPUNIT_ASSERT( evaluator.GetNumNodes() == 7 );
+
+	ValuationMap<FloatSemiring> valuation = {
+		{ Var::GetVarId("a"), FloatSemiring(0.25) },
+		{ Var::GetVarId("b"), FloatSemiring(2) },
+		{ Var::GetVarId("c"), FloatSemiring(0.25) } };
+	auto check = [&](const std::vector<FloatSemiring> &result) {
+		CPPUNIT_ASSERT( result.size() == elements.size() );
+		for (std::size_t i = 0; i < elements.size(); ++i) {
+			CPPUNIT_ASSERT( result[i] == elements[i].Eval(valuation) );
+		}
+	};
+	check(evaluator.Eval(valuation));
+	CPPUNIT_ASSERT( evaluator.GetNumRecomputed() == 4 );
+
+	// nothing changed
+	check(evaluator.Eval(valuation));
+	CPPUNIT_ASSERT( evaluator.GetNumRecomputed() == 0 );
+
+	// only a + c, its star and b*c depend on c
+	valuation[Var::GetVarId("c")] = FloatSemiring(0.5);
+	check(evaluator.Eval(valuation));
+	CPPUNIT_ASSERT( evaluator.GetNumRecomputed() == 3 );
+}
+
+void FreeSemiringTest::testRegisterMachine()
+{
+	// a*b, (a + c)*, b*a (not commutative), a*b again, 1 and 0
+	std::vector<FreeSemiring> elements = { (*a) * (*b), ((*a) + (*c)).star(), (*b) * (*a),
+	                                       (*a) * (*b), FreeSemiring::one(), FreeSemiring::null() };
+	ValuationMap<FloatSemiring> valuation = {
+		{ Var::GetVarId("a"), FloatSemiring(0.25) },
+		{ Var::GetVarId("b"), FloatSemiring(2) },
+		{ Var::GetVarId("c"), FloatSemiring(0.5) } };
+	RegisterMachine<FloatSemiring> machine{elements};
+	for (int i = 0; i < 2; ++i) {
+		std::vector<FloatSemiring> result = machine.Eval(valuation);
+		CPPUNIT_ASSERT( result.size() == elements.size() );
+		for (std::size_t j = 0; j < elements.size(); ++j) {
+			CPPUNIT_ASSERT( result[j] == elements[j].Eval(valuation) );
+		}
+		valuation[Var::GetVarId("c")] = FloatSemiring(0.125);
+	}
+
+	// the partial sums of a*x_0 + ... + a*x_99 only need a few registers,
+	// no matter on which side the sum is nested
+	FreeSemiring left = FreeSemiring::null();
+	FreeSemiring right = FreeSemiring::null();
+	FloatSemiring expected = FloatSemiring::null();
+	for (int i = 0; i < 100; ++i) {
+		VarId x = Var::GetVarId("x" + std::to_string(i));
+		valuation[x] = FloatSemiring(i);
+		left = left + (*a) * FreeSemiring(x);
+		right = (*a) * FreeSemiring(x) + right;
+		expected = expected + FloatSemiring(0.25) * FloatSemiring(i);
+	}
+	RegisterMachine<FloatSemiring> sums{{left, right}};
+	CPPUNIT_ASSERT( sums.GetNumRegisters() <= 5 );
+	std::vector<FloatSemiring> result = sums.Eval(valuation);
+	CPPUNIT_ASSERT( result[0] == expected && result[1] == expected );
+}
+
+void FreeSemiringTest::testArena()
+{
+	struct Pair { int x; int y; };
+	Arena<Pair> arena;
+	std::vector<Pair*> pairs;
+	for (int i = 0; i < 10000; ++i) {
+		pairs.push_back(new (arena.Allocate()) Pair{i, -i});
+	}
+	CPPUNIT_ASSERT(arena.size() == 10000);
+	// consecutive objects lie next to each other (within a chunk)
+	CPPUNIT_ASSERT(pairs[1] - pairs[0] == 1 && pairs[2] - pairs[1] == 1);
+
+	// freed slots are reused first, the other objects are untouched
+	arena.Free(pairs[17]);
+	arena.Free(pairs[4711]);
+	CPPUNIT_ASSERT(arena.size() == 9998);
+	Pair *reused = new (arena.Allocate()) Pair{1, 2};
+	CPPUNIT_ASSERT(reused == pairs[4711]);
+	Pair *reused_again = new (arena.Allocate()) Pair{3, 4};
+	CPPUNIT_ASSERT(reused_again == pairs[17]);
+	for (int i = 0; i < 10000; ++i) {
+		if (i != 17 && i != 4711) {
+			CPPUNIT_ASSERT(pairs[i]->x == i && pairs[i]->y == -i);
+		}
+	}
+}
+
+void FreeSemiringTest::testGarbageCollection()
+{
+	{
+		NodeFactory factory;
+		NodePtr x = factory.NewElement(Var::GetVarId("a"));
+		NodePtr y = factory.NewElement(Var::GetVarId("b"));
+		NodePtr sum = factory.NewAddition(x, y);
+		NodePtr product = factory.NewMultiplication(sum, x);
+		NodePtr star = factory.NewStar(product);
+		CPPUNIT_ASSERT( factory.GetNumNodes() == 5 );
+
+		// x and y are still reachable from sum
+		NodeFactory::Release(x);
+		NodeFactory::Release(y);
+		NodeFactory::Release(product);
+		NodeFactory::Release(star);
+		factory.GC();
+		CPPUNIT_ASSERT( factory.GetNumNodes() == 3 );
+		NodePtr b_again = factory.NewElement(Var::GetVarId("b"));
+		NodePtr a_again = factory.NewElement(Var::GetVarId("a"));
+		CPPUNIT_ASSERT( b_again == y && a_again == x );
+		CPPUNIT_ASSERT( factory.NewAddition(b_again, a_again) == sum );
+
+		// collected automatically once there are 8 nodes
+		factory.SetGCThreshold(8);
+		for (int i = 0; i < 100; ++i) {
+			NodePtr z = factory.NewElement(Var::GetVarId("gc" + std::to_string(i)));
+			NodeFactory::Release(factory.NewMultiplication(sum, z));
+			NodeFactory::Release(z);
+			CPPUNIT_ASSERT( factory.GetNumNodes() <= 8 );
+		}
+	}
+
+	FreeSemiring sum = (*a) + (*b);
+	for (int i = 0; i < 1000; ++i) {
+		FreeSemiring tmp = sum * FreeSemiring(Var::GetVarId("gc" + std::to_string(i)));
+	}
+	const std::size_t before = FreeSemiring::GetNumNodes();
+	FreeSemiring::GC();
+	CPPUNIT_ASSERT( FreeSemiring::GetNumNodes() + 2000 <= before );
+	CPPUNIT_ASSERT( sum == (*b) + (*a) );
+	CPPUNIT_ASSERT( sum.string() == "(\"a\"+\"b\")" );
+}
+
+void FreeSemiringTest::testConcurrentFactory()
+{
+	const std::size_t num_threads = 4;
+	const std::size_t num_terms = 1000;
+	std::vector<VarId> xs, ys;
+	for (std::size_t i = 0; i < num_terms; ++i) {
+		xs.push_back(Var::GetVarId("concurrent_x" + std::to_string(i)));
+		ys.push_back(Var::GetVarId("concurrent_y" + std::to_string(i)));
+	}
+
+	// collected automatically (and concurrently) while the threads are running
+	NodeFactory factory{256};
+	std::vector< std::vector<NodePtr> > stars(num_threads, std::vector<NodePtr>(num_terms));
+	std::vector<std::thread> threads;
+	for (std::size_t t = 0; t < num_threads; ++t) {
+		threads.emplace_back([&, t]() {
+			// every thread builds the same terms in a different order
+			const std::size_t stride[] = {1, 3, 7, 9};
+			for (std::size_t k = 0; k < num_terms; ++k) {
+				const std::size_t i = (k * stride[t]) % num_terms;
+				NodePtr x = factory.NewElement(xs[i]);
+				NodePtr y = factory.NewElement(ys[i]);
+				NodePtr product = factory.NewMultiplication(x, y);
+				NodePtr sum = factory.NewAddition(product, x);
+				stars[t][i] = factory.NewStar(sum);
+				NodeFactory::Release(factory.NewMultiplication(y, x));  // garbage
+				NodeFactory::Release(x);
+				NodeFactory::Release(y);
+				NodeFactory::Release(product);
+				NodeFactory::Release(sum);
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	// x, y, x*y, x*y + x and its star for every term
+	factory.GC();
+	CPPUNIT_ASSERT( factory.GetNumNodes() == 5 * num_terms );
+	for (std::size_t t = 1; t < num_threads; ++t) {
+		CPPUNIT_ASSERT( stars[t] == stars[0] );
+	}
+
+	for (auto &thread_stars : stars) {
+		for (auto star : thread_stars) {
+			NodeFactory::Release(star);
+		}
+	}
+	factory.GC();
+	CPPUNIT_ASSERT( factory.GetNumNodes() == 0 );
+}
+
+void FreeSemiringTest::testCache()
+{
+	char directory[] = "/tmp/fpsolve-cache-XXXXXX";
+	CPPUNIT_ASSERT( mkdtemp(directory) != nullptr );
+	const std::string previous = FreeSemiringCache::Directory();
+	FreeSemiringCache::Directory() = directory;
+
+	const std::vector<std::uint32_t> key{2, 3, 5};
+	const std::vector<VarId> leaves{
+		Var::GetVarId("a"), Var::GetVarId("b"), Var::GetVarId("c")};
+	const std::vector<FreeSemiring> elements{
+		(*a) * (*b) + (*c), ((*a) + FreeSemiring::one()).star(), FreeSemiring::null()};
+	CPPUNIT_ASSERT( FreeSemiringCache::Store("test", key, SemiringLaws(), leaves, elements) );
+
+	std::vector<FreeSemiring> loaded;
+	CPPUNIT_ASSERT( FreeSemiringCache::Load("test", key, SemiringLaws(), leaves, &loaded) );
+	CPPUNIT_ASSERT( loaded == elements );
+
+	// the leaves are renamed
+	const std::vector<VarId> other_leaves{
+		Var::GetVarId("cache_x"), Var::GetVarId("cache_y"), Var::GetVarId("cache_z")};
+	CPPUNIT_ASSERT( FreeSemiringCache::Load("test", key, SemiringLaws(), other_leaves, &loaded) );
+	CPPUNIT_ASSERT( loaded.size() == 3 );
+	CPPUNIT_ASSERT( loaded[0] == FreeSemiring{other_leaves[0]} * FreeSemiring{other_leaves[1]} +
+	                             FreeSemiring{other_leaves[2]} );
+	CPPUNIT_ASSERT( loaded[2] == FreeSemiring::null() );
+
+	// a different key, different laws or too few leaves
+	CPPUNIT_ASSERT( !FreeSemiringCache::Load("test", {2, 3, 6}, SemiringLaws(), leaves, &loaded) );
+	CPPUNIT_ASSERT( !FreeSemiringCache::Load("test", key, SemiringLaws{true, true}, leaves, &loaded) );
+	CPPUNIT_ASSERT( !FreeSemiringCache::Load("test", key, SemiringLaws(), {leaves[0]}, &loaded) );
+	// a variable that is not a leaf cannot be stored
+	CPPUNIT_ASSERT( !FreeSemiringCache::Store("test", key, SemiringLaws(), {leaves[0]}, elements) );
+
+	FreeSemiringCache::Directory() = previous;
+	DIR *dir = opendir(directory);
+	CPPUNIT_ASSERT( dir != nullptr );
+	while (dirent *entry = readdir(dir)) {
+		const std::string name = entry->d_name;
+		if (name != "." && name != "..") {
+			std::remove((std::string{directory} + "/" + name).c_str());
+		}
+	}
+	closedir(dir);
+	CPPUNIT_ASSERT( rmdir(directory) == 0 );
+}
@@ -12,6 +12,15 @@ class FreeSemiringTest : public CppUnit::TestFixture
 	CPPUNIT_TEST(testAddition);
 	CPPUNIT_TEST(testMultiplication);
 	CPPUNIT_TEST(testStar);
+	CPPUNIT_TEST(testSimplification);
+	CPPUNIT_TEST(testCompiledDag);
+	CPPUNIT_TEST(testParallelDagEvaluator);
+	CPPUNIT_TEST(testIncrementalEvaluator);
+	CPPUNIT_TEST(testRegisterMachine);
+	CPPUNIT_TEST(testArena);
+	CPPUNIT_TEST(testGarbageCollection);
+	CPPUNIT_TEST(testConcurrentFactory);
+	CPPUNIT_TEST(testCache);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -23,6 +32,15 @@ protected:
 	void testAddition();
 	void testMultiplication();
 	void testStar();
+	void testSimplification();
+	void testCompiledDag();
+	void testParallelDagEvaluator();
+	void testIncrementalEvaluator();
+	void testRegisterMachine();
+	void testArena();
+	void testGarbageCollection();
+	void testConcurrentFactory();
+	void testCache();
 
 private:
 	FreeSemiring *a, *b, *c;
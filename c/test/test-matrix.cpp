@@ -195,3 +195,236 @@ void MatrixTest::testStar()
   CPPUNIT_ASSERT(test_matrix2.solve_LDU(test_vec2) == test_matrix2.star3()*test_vec2);
 
 }
+
+// the sparse LDU decomposition has to agree with the dense one
+void MatrixTest::testSparseLDU()
+{
+  std::vector<unsigned int> seeds{42,23,11805,24890};
+
+  for (auto &seed : seeds) {
+    srand(seed);
+
+    // random sparse matrix with about 3 entries per row
+    int size = 100;
+    std::vector<TS> elements;
+    for(unsigned int i = 0; i < size*size; i++)
+    {
+      int r = rand() % (20 * size / 3);
+      if(r == 0 || r > 20)
+        elements.push_back(TS::null());
+      else
+        elements.push_back(TS(r));
+    }
+    Matrix<TS> test_matrix(size, elements);
+    SparseMatrix<TS> sparse_matrix(test_matrix);
+    CPPUNIT_ASSERT(sparse_matrix.ToDense() == test_matrix);
+
+    std::vector<TS> elements_vec;
+    for(unsigned int i = 0; i < size; i++)
+    {
+      int r = rand() % 40;
+      if(r > 20 || r == 0)
+        elements_vec.push_back(TS::null());
+      else
+        elements_vec.push_back(TS(r));
+    }
+    Matrix<TS> test_vec(size, elements_vec);
+
+    // the factors agree on the fill pattern, all other entries are zero
+    Matrix<TS> dense_ldu = test_matrix;
+    Matrix<TS>::LDU_decomposition_2(dense_ldu);
+    auto sparse_ldu = SparseMatrix<TS>::LDU_decomposition(
+        sparse_matrix, sparse_matrix.getPattern().LDU_pattern());
+    CPPUNIT_ASSERT(sparse_ldu.ToDense() == dense_ldu);
+
+    CPPUNIT_ASSERT(sparse_matrix.solve_LDU(test_vec) == test_matrix.solve_LDU(test_vec));
+  }
+
+  Matrix<Rat> test_matrix2(3, {Rat("1/3"), Rat("0"), Rat("1/5"),
+                               Rat("0"), Rat("1/2"), Rat("2/3"),
+                               Rat("0"), Rat("5/78"), Rat("1/7")});
+  Matrix<Rat> test_vec2(3, {Rat("1/5"), Rat("13/4"),Rat("4/5")});
+  CPPUNIT_ASSERT(SparseMatrix<Rat>(test_matrix2).solve_LDU(test_vec2) ==
+                 test_matrix2.solve_LDU(test_vec2));
+}
+
+void MatrixTest::testOrdering()
+{
+  // arrow matrix: the first row and column and the diagonal are nonzero, in
+  // the natural order the LDU factors are completely filled
+  int size = 20;
+  std::vector<TS> elements;
+  for (int r = 0; r < size; r++) {
+    for (int c = 0; c < size; c++) {
+      if (r == 0 || c == 0 || r == c)
+        elements.push_back(TS(r + c + 1));
+      else
+        elements.push_back(TS::null());
+    }
+  }
+  Matrix<TS> arrow(size, elements);
+  SparseMatrix<TS> sparse_arrow(arrow);
+  CPPUNIT_ASSERT(sparse_arrow.getPattern().LDU_pattern()->getNonZeros() == size * size);
+
+  std::vector<VariableOrdering> orderings{VariableOrdering::ReverseCuthillMcKee,
+                                          VariableOrdering::MinimumDegree};
+  for (auto ordering : orderings) {
+    auto order = ComputeOrdering(sparse_arrow.getPattern(), ordering);
+
+    std::vector<std::size_t> sorted = order;
+    std::sort(sorted.begin(), sorted.end());
+    for (std::size_t k = 0; k < sorted.size(); k++)
+      CPPUNIT_ASSERT(sorted[k] == k);
+
+    // the permuted matrix has no fill-in besides the diagonal
+    std::vector<TS> permuted;
+    for (int r = 0; r < size; r++)
+      for (int c = 0; c < size; c++)
+        permuted.push_back(arrow.At(order[r], order[c]));
+    SparseMatrix<TS> sparse_permuted(Matrix<TS>(size, permuted));
+    CPPUNIT_ASSERT(sparse_permuted.getPattern().LDU_pattern()->getNonZeros() <= 3 * size);
+
+    // and it still has the same closure (up to the permutation)
+    Matrix<TS> star = arrow.star();
+    Matrix<TS> permuted_star = sparse_permuted.ToDense().star();
+    for (int r = 0; r < size; r++)
+      for (int c = 0; c < size; c++)
+        CPPUNIT_ASSERT(permuted_star.At(r, c) == star.At(order[r], order[c]));
+  }
+}
+
+void MatrixTest::testParallelStar()
+{
+  // larger than a few tiles of the blocked Floyd-Warshall and not a multiple
+  // of the tile size
+  srand(1234);
+  int size = 150;
+  std::vector<TS> elements;
+  for (unsigned int i = 0; i < size*size; i++) {
+    int r = rand() % 100;
+    if (r > 20 || r == 0)
+      elements.push_back(TS::null());
+    else
+      elements.push_back(TS(r));
+  }
+  Matrix<TS> test_matrix(size, elements);
+
+  auto rec_star = test_matrix.star3();
+  auto rec_star2 = test_matrix.star();
+  auto fw_star = test_matrix.star2();
+  CPPUNIT_ASSERT(rec_star2 == rec_star);
+  CPPUNIT_ASSERT(fw_star == rec_star);
+
+  ThreadPool pool{4};
+  SolverThreadPoolScope pool_scope{&pool};
+  CPPUNIT_ASSERT(test_matrix.star() == rec_star);
+  CPPUNIT_ASSERT(test_matrix.star2() == rec_star);
+}
+
+// product computed with the semiring operations (as in the generic
+// Matrix::operator*)
+template <typename SR>
+static Matrix<SR> NaiveProduct(const Matrix<SR> &a, const Matrix<SR> &b)
+{
+  std::vector<SR> result;
+  for (std::size_t r = 0; r < a.getRows(); ++r) {
+    for (std::size_t c = 0; c < b.getColumns(); ++c) {
+      SR sum = a.At(r, 0) * b.At(0, c);
+      for (std::size_t k = 1; k < a.getColumns(); ++k)
+        sum += a.At(r, k) * b.At(k, c);
+      result.push_back(sum);
+    }
+  }
+  return Matrix<SR>(a.getRows(), result);
+}
+
+// random matrix, make_elem maps a random number in [0, 100) to an element
+template <typename SR, typename Function>
+static Matrix<SR> RandomMatrix(int rows, int columns, Function make_elem)
+{
+  std::vector<SR> elements;
+  for (int i = 0; i < rows * columns; i++)
+    elements.push_back(make_elem(rand() % 100));
+  return Matrix<SR>(rows, elements);
+}
+
+void MatrixTest::testScalarKernels()
+{
+  srand(2718);
+  // sizes that are not multiples of the vector width nor of the tile size
+  const int n = 77;
+  const int m = 13;
+
+  auto make_ts = [](int r) {
+    if (r < 50) return TS::null();
+    if (r == 99) return TS(NEGINFTY);
+    return TS(r - 60);
+  };
+  auto ts_a = RandomMatrix<TS>(n, m, make_ts);
+  auto ts_b = RandomMatrix<TS>(m, n, make_ts);
+  CPPUNIT_ASSERT(ts_a * ts_b == NaiveProduct(ts_a, ts_b));
+  auto ts_c = RandomMatrix<TS>(n, n, [](int r) { return r < 80 ? TS::null() : TS(r % 10); });
+  CPPUNIT_ASSERT(ts_c.star() == ts_c.star3());
+  CPPUNIT_ASSERT(ts_c.star2() == ts_c.star3());
+
+  auto make_vit = [](int r) { return r < 30 ? ViterbiSemiring::null() : ViterbiSemiring(r / 100.0f); };
+  auto vit_a = RandomMatrix<ViterbiSemiring>(n, m, make_vit);
+  auto vit_b = RandomMatrix<ViterbiSemiring>(m, n, make_vit);
+  CPPUNIT_ASSERT(vit_a * vit_b == NaiveProduct(vit_a, vit_b));
+  auto vit_c = RandomMatrix<ViterbiSemiring>(n, n, make_vit);
+  // products of floats are rounded differently by the recursive star, but
+  // the kernels do the same operations as the generic Floyd-Warshall
+  CPPUNIT_ASSERT(vit_c.star() == vit_c.FloydWarshall());
+
+  auto make_mm = [](int r) { return r < 30 ? MaxMinSemiring::null() : MaxMinSemiring(r - 50.0f); };
+  auto mm_a = RandomMatrix<MaxMinSemiring>(n, m, make_mm);
+  auto mm_b = RandomMatrix<MaxMinSemiring>(m, n, make_mm);
+  CPPUNIT_ASSERT(mm_a * mm_b == NaiveProduct(mm_a, mm_b));
+  auto mm_c = RandomMatrix<MaxMinSemiring>(n, n, make_mm);
+  CPPUNIT_ASSERT(mm_c.star() == mm_c.star3());
+
+  auto make_bool = [](int r) { return BoolSemiring(r > 95); };
+  auto bool_a = RandomMatrix<BoolSemiring>(n, m, make_bool);
+  auto bool_b = RandomMatrix<BoolSemiring>(m, n, make_bool);
+  CPPUNIT_ASSERT(bool_a * bool_b == NaiveProduct(bool_a, bool_b));
+  auto bool_c = RandomMatrix<BoolSemiring>(n, n, make_bool);
+  CPPUNIT_ASSERT(bool_c.star() == bool_c.star3());
+
+  auto make_fs = [](int r) { return r < 10 ? FS(INFTY_FLOAT) : FS(r / (100.0 * n)); };
+  auto fs_a = RandomMatrix<FS>(n, m, make_fs);
+  auto fs_b = RandomMatrix<FS>(m, n, make_fs);
+  CPPUNIT_ASSERT(fs_a * fs_b == NaiveProduct(fs_a, fs_b));
+  auto fs_c = RandomMatrix<FS>(n, n, [](int r) { return FS(r / (200.0 * n)); });
+  CPPUNIT_ASSERT(fs_c.star() == fs_c.FloydWarshall());
+}
+
+void MatrixTest::testBitMatrix()
+{
+  BitMatrix bits{3, 70};
+  bits.Set(0, 0);
+  bits.Set(1, 64);
+  bits.Set(2, 69);
+  CPPUNIT_ASSERT(bits.Get(0, 0) && bits.Get(1, 64) && bits.Get(2, 69));
+  CPPUNIT_ASSERT(!bits.Get(0, 64) && !bits.Get(1, 0) && !bits.Get(2, 68));
+
+  // more than two words per row and a chain through all of them, so that
+  // the closure has to propagate across word boundaries
+  srand(4711);
+  const int n = 130;
+  auto make_bool = [](int r) { return BoolSemiring(r > 97); };
+  auto bool_c = RandomMatrix<BoolSemiring>(n, n, make_bool);
+  for (int i = 0; i + 1 < n; i += 2) {
+    bool_c.At(i, i + 1) = BoolSemiring::one();
+  }
+  auto expected = bool_c.star3();
+  CPPUNIT_ASSERT(bool_c.star() == expected);
+  CPPUNIT_ASSERT(bool_c.star2() == expected);
+  auto bool_a = RandomMatrix<BoolSemiring>(n, 67, make_bool);
+  auto bool_b = RandomMatrix<BoolSemiring>(67, n, make_bool);
+  CPPUNIT_ASSERT(bool_a * bool_b == NaiveProduct(bool_a, bool_b));
+
+  ThreadPool pool{4};
+  SolverThreadPoolScope pool_scope{&pool};
+  CPPUNIT_ASSERT(bool_c.star() == expected);
+  CPPUNIT_ASSERT(bool_a * bool_b == NaiveProduct(bool_a, bool_b));
+}
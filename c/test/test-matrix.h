@@ -7,7 +7,13 @@
 #include "../src/semirings/tropical-semiring.h"
 #include "../src/semirings/float-semiring.h"
 #include "../src/semirings/prec-rat-semiring.h"
+#include "../src/semirings/bool-semiring.h"
+#include "../src/semirings/maxmin-semiring.h"
+#include "../src/semirings/viterbi-semiring.h"
+#include "../src/datastructs/bit_matrix.h"
 #include "../src/datastructs/matrix.h"
+#include "../src/datastructs/sparse_matrix.h"
+#include "../src/datastructs/sparse_ordering.h"
 
 
 class MatrixTest : public CppUnit::TestFixture
@@ -16,6 +22,11 @@ class MatrixTest : public CppUnit::TestFixture
 	CPPUNIT_TEST(testAddition);
 	CPPUNIT_TEST(testMultiplication);
 	CPPUNIT_TEST(testStar);
+	CPPUNIT_TEST(testSparseLDU);
+	CPPUNIT_TEST(testOrdering);
+	CPPUNIT_TEST(testParallelStar);
+	CPPUNIT_TEST(testScalarKernels);
+	CPPUNIT_TEST(testBitMatrix);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -26,6 +37,11 @@ protected:
 	void testAddition();
 	void testMultiplication();
 	void testStar();
+	void testSparseLDU();
+	void testOrdering();
+	void testParallelStar();
+	void testScalarKernels();
+	void testBitMatrix();
 
 private:
 	FreeSemiring *a, *b, *c, *d, *e, *f, *g, *h, *i, *j, *k, *l, *m, *n, *o, *p, *q, *r;
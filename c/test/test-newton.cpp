@@ -0,0 +1,467 @@
+/*
+ * test-newton.cpp
+ */
+
+#include <cmath>
+#include <cstdlib>
+
+#include "test-newton.h"
+
+#include "../src/datastructs/equations.h"
+#include "../src/polynomials/commutative_polynomial.h"
+#include "../src/polynomials/non_commutative_polynomial.h"
+#include "../src/semirings/bool-semiring.h"
+#include "../src/semirings/float-semiring.h"
+#include "../src/semirings/maxmin-semiring.h"
+#include "../src/semirings/tropical-semiring.h"
+#include "../src/semirings/viterbi-semiring.h"
+#include "../src/datastructs/weak_topological_order.h"
+#include "../src/solvers/chaotic_iteration.h"
+#include "../src/solvers/horn.h"
+#include "../src/solvers/kleene_seminaive.h"
+#include "../src/solvers/knuth.h"
+#include "../src/solvers/newton_generic.h"
+#include "../src/solvers/solver_utils.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(NewtonTest);
+
+// never stop early, i.e., always do max_iter iterations
+template <typename SR>
+struct NeverConverged {
+  static bool Converged(const CompiledPolynomialSystem<SR> &,
+                        const Matrix<SR> &, const Matrix<SR> &) {
+    return false;
+  }
+};
+
+template <typename SR>
+using NewtonCLNoStop = GenericNewton<SR, CommutativeConcreteLinSolver,
+                                     CommutativeDeltaGenerator,
+                                     CommutativePolynomial, NeverConverged>;
+
+// random sparse quadratic system x_i = c_i1 x_j x_k + c_i2 x_l + c_i3 (some of
+// the constants are missing, so some variables stay zero)
+template <typename SR, typename Function>
+static GenericEquations<CommutativePolynomial, SR>
+RandomQuadraticSystem(const std::string &prefix, std::size_t n, Function make_coeff) {
+  std::vector<VarId> vars;
+  for (std::size_t i = 0; i < n; ++i) {
+    vars.push_back(Var::GetVarId(prefix + std::to_string(i)));
+  }
+  GenericEquations<CommutativePolynomial, SR> equations;
+  for (std::size_t i = 0; i < n; ++i) {
+    CommutativePolynomial<SR> poly{
+      {make_coeff(rand() % 100), {vars[rand() % n], vars[rand() % n]}}};
+    poly += CommutativePolynomial<SR>{{make_coeff(rand() % 100), {vars[rand() % n]}}};
+    if (rand() % 4 != 0) {
+      poly += make_coeff(rand() % 100);
+    }
+    equations.push_back(std::make_pair(vars[i], poly));
+  }
+  return equations;
+}
+
+void NewtonTest::setUp()
+{
+  std::cout << "Newton-Test:" << std::endl;
+}
+
+void NewtonTest::tearDown()
+{
+}
+
+void NewtonTest::testIdempotentConvergence()
+{
+  // x0 = 1*x0*x1 + 7, x1 = 2*x1*x2 + 3, ..., x5 = 1*x5*x5 + 4
+  const std::size_t n = 6;
+  GenericEquations<CommutativePolynomial, TropicalSemiring> equations;
+  std::vector<VarId> vars;
+  for (std::size_t i = 0; i < n; ++i) {
+    vars.push_back(Var::GetVarId("newton_x" + std::to_string(i)));
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    VarId next = vars[std::min(i + 1, n - 1)];
+    CommutativePolynomial<TropicalSemiring> poly{
+      {TropicalSemiring(i % 3), {vars[i], next}}};
+    poly += TropicalSemiring(n - i + 1);
+    equations.push_back(std::make_pair(vars[i], poly));
+  }
+
+  const std::size_t max_iter = 50;
+  NewtonCL<TropicalSemiring> newton;
+  auto result = newton.solve_fixpoint(equations, max_iter);
+  NewtonCLNoStop<TropicalSemiring> newton_no_stop;
+  auto reference = newton_no_stop.solve_fixpoint(equations, max_iter);
+
+  CPPUNIT_ASSERT(newton.GetIterations() < max_iter);
+  CPPUNIT_ASSERT(newton_no_stop.GetIterations() == max_iter);
+  CPPUNIT_ASSERT(result == reference);
+}
+
+void NewtonTest::testFloatConvergence()
+{
+  // x = 0.5*xx + 0.25 has the least solution 1 - sqrt(0.5)
+  VarId x = Var::GetVarId("newton_float_x");
+  CommutativePolynomial<FloatSemiring> poly{{FloatSemiring(0.5), {x, x}}};
+  poly += FloatSemiring(0.25);
+  GenericEquations<CommutativePolynomial, FloatSemiring> equations;
+  equations.push_back(std::make_pair(x, poly));
+
+  const std::size_t max_iter = 100;
+  NewtonCLDU<FloatSemiring> newton;
+  auto result = newton.solve_fixpoint(equations, max_iter);
+
+  CPPUNIT_ASSERT(newton.GetIterations() < max_iter);
+  CPPUNIT_ASSERT(std::fabs(result.at(x).getValue() - (1 - std::sqrt(0.5))) < 1e-9);
+}
+
+void NewtonTest::testSymbolicLDU()
+{
+  // sparse system with fill-in: x0 depends on all the others and they depend
+  // on x0, x_i = i*x0*x_i + x_{i+1} + 1 (tropical)
+  const std::size_t n = 5;
+  GenericEquations<CommutativePolynomial, TropicalSemiring> equations;
+  std::vector<VarId> vars;
+  for (std::size_t i = 0; i < n; ++i) {
+    vars.push_back(Var::GetVarId("newton_sldu_x" + std::to_string(i)));
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    CommutativePolynomial<TropicalSemiring> poly{
+      {TropicalSemiring(i), {vars[0], vars[i]}}};
+    poly += CommutativePolynomial<TropicalSemiring>{
+      {TropicalSemiring::one(), {vars[(i + 1) % n]}}};
+    poly += TropicalSemiring(1);
+    equations.push_back(std::make_pair(vars[i], poly));
+  }
+
+  NewtonSLDU<TropicalSemiring> symbolic;
+  NewtonCLDU<TropicalSemiring> concrete;
+  CPPUNIT_ASSERT(symbolic.solve_fixpoint(equations, n + 1) ==
+                 concrete.solve_fixpoint(equations, n + 1));
+
+  // the fill-reducing orderings do not change the result
+  std::vector<VariableOrdering> orderings{VariableOrdering::ReverseCuthillMcKee,
+                                          VariableOrdering::MinimumDegree};
+  for (auto ordering : orderings) {
+    NewtonSLDU<TropicalSemiring> reordered;
+    CPPUNIT_ASSERT(reordered.solve_fixpoint(equations, n + 1, ordering) ==
+                   concrete.solve_fixpoint(equations, n + 1));
+  }
+}
+
+void NewtonTest::testParallelEvaluation()
+{
+  // dense random quadratic float system, x_i = sum_jk c_ijk x_j x_k + sum_j c_ij x_j + c_i
+  srand(4711);
+  const std::size_t n = 60;
+  std::vector<VarId> vars;
+  for (std::size_t i = 0; i < n; ++i) {
+    vars.push_back(Var::GetVarId("newton_par_x" + std::to_string(i)));
+  }
+  GenericEquations<CommutativePolynomial, FloatSemiring> equations;
+  for (std::size_t i = 0; i < n; ++i) {
+    CommutativePolynomial<FloatSemiring> poly{FloatSemiring(0.1)};
+    for (std::size_t j = 0; j < n; ++j) {
+      poly += CommutativePolynomial<FloatSemiring>{
+        {FloatSemiring((1 + rand() % 100) / (100.0 * n * n)), {vars[j], vars[(i + j) % n]}}};
+      poly += CommutativePolynomial<FloatSemiring>{
+        {FloatSemiring((1 + rand() % 100) / (400.0 * n)), {vars[j]}}};
+    }
+    equations.push_back(std::make_pair(vars[i], poly));
+  }
+
+  const std::size_t max_iter = 20;
+  NewtonCLDU<FloatSemiring> sequential;
+  auto reference = sequential.solve_fixpoint(equations, max_iter);
+
+  // the result must not depend on the number of threads (not even in the
+  // last bit of the floats)
+  ThreadPool pool{4};
+  SolverThreadPoolScope pool_scope{&pool};
+  NewtonCLDU<FloatSemiring> parallel;
+  auto result = parallel.solve_fixpoint(equations, max_iter);
+
+  CPPUNIT_ASSERT(parallel.GetIterations() == sequential.GetIterations());
+  for (const auto &var : vars) {
+    CPPUNIT_ASSERT(result.at(var).getValue() == reference.at(var).getValue());
+  }
+}
+
+void NewtonTest::testParallelSymbolic()
+{
+  // the symbolic solvers evaluate the levels of their free elements in
+  // parallel (RegisterMachine for float, IncrementalEvaluator for tropical),
+  // which must not change the result
+  srand(2015);
+  const std::size_t n = 40;
+  auto floats = RandomQuadraticSystem<FloatSemiring>(
+      "newton_par_symb_f", n, [](int r) { return FloatSemiring((1 + r) / 1000.0); });
+  auto tropical = RandomQuadraticSystem<TropicalSemiring>(
+      "newton_par_symb_t", n, [](int r) { return TropicalSemiring(r); });
+
+  const std::size_t max_iter = 10;
+  Newton<FloatSemiring> sequential_float;
+  NewtonSLDU<FloatSemiring> sequential_float_ldu;
+  Newton<TropicalSemiring> sequential_tropical;
+  NewtonSLDU<TropicalSemiring> sequential_tropical_ldu;
+  const auto reference_float = sequential_float.solve_fixpoint(floats, max_iter);
+  const auto reference_float_ldu = sequential_float_ldu.solve_fixpoint(floats, max_iter);
+  const auto reference_tropical = sequential_tropical.solve_fixpoint(tropical, n + 1);
+  const auto reference_tropical_ldu = sequential_tropical_ldu.solve_fixpoint(tropical, n + 1);
+
+  ThreadPool pool{4};
+  SolverThreadPoolScope pool_scope{&pool};
+  Newton<FloatSemiring> parallel_float;
+  NewtonSLDU<FloatSemiring> parallel_float_ldu;
+  Newton<TropicalSemiring> parallel_tropical;
+  NewtonSLDU<TropicalSemiring> parallel_tropical_ldu;
+  const auto result_float = parallel_float.solve_fixpoint(floats, max_iter);
+  const auto result_float_ldu = parallel_float_ldu.solve_fixpoint(floats, max_iter);
+  CPPUNIT_ASSERT(parallel_tropical.solve_fixpoint(tropical, n + 1) == reference_tropical);
+  CPPUNIT_ASSERT(parallel_tropical_ldu.solve_fixpoint(tropical, n + 1) == reference_tropical_ldu);
+  for (const auto &eq : floats) {
+    CPPUNIT_ASSERT(result_float.at(eq.first).getValue() ==
+                   reference_float.at(eq.first).getValue());
+    CPPUNIT_ASSERT(result_float_ldu.at(eq.first).getValue() ==
+                   reference_float_ldu.at(eq.first).getValue());
+  }
+}
+
+void NewtonTest::testKnuth()
+{
+  srand(1977);
+  const std::size_t n = 40;
+
+  auto tropical = RandomQuadraticSystem<TropicalSemiring>(
+      "knuth_trop_x", n, [](int r) { return TropicalSemiring(r); });
+  KnuthSolver<TropicalSemiring> knuth_tropical;
+  NewtonCLDU<TropicalSemiring> newton_tropical;
+  CPPUNIT_ASSERT(knuth_tropical.solve_fixpoint(tropical, n + 1) ==
+                 newton_tropical.solve_fixpoint(tropical, n + 1));
+
+  auto viterbi = RandomQuadraticSystem<ViterbiSemiring>(
+      "knuth_vit_x", n, [](int r) { return ViterbiSemiring(r / 128.0f); });
+  KnuthSolver<ViterbiSemiring> knuth_viterbi;
+  NewtonCLDU<ViterbiSemiring> newton_viterbi;
+  CPPUNIT_ASSERT(knuth_viterbi.solve_fixpoint(viterbi, n + 1) ==
+                 newton_viterbi.solve_fixpoint(viterbi, n + 1));
+
+  auto maxmin = RandomQuadraticSystem<MaxMinSemiring>(
+      "knuth_mm_x", n, [](int r) { return MaxMinSemiring(r - 50.0f); });
+  KnuthSolver<MaxMinSemiring> knuth_maxmin;
+  NewtonCLDU<MaxMinSemiring> newton_maxmin;
+  CPPUNIT_ASSERT(knuth_maxmin.solve_fixpoint(maxmin, n + 1) ==
+                 newton_maxmin.solve_fixpoint(maxmin, n + 1));
+
+  // negative weights are not superior, the solver has to fall back to Newton
+  auto negative = RandomQuadraticSystem<TropicalSemiring>(
+      "knuth_neg_x", n, [](int r) { return TropicalSemiring(r - 10); });
+  KnuthSolver<TropicalSemiring> knuth_negative;
+  CPPUNIT_ASSERT(knuth_negative.solve_fixpoint(negative, n + 1) ==
+                 newton_tropical.solve_fixpoint(negative, n + 1));
+}
+
+void NewtonTest::testHorn()
+{
+  srand(1984);
+  const std::size_t n = 60;
+  auto equations = RandomQuadraticSystem<BoolSemiring>(
+      "horn_x", n, [](int) { return BoolSemiring::one(); });
+  HornSolver<BoolSemiring> horn;
+  NewtonCL<BoolSemiring> newton;
+  auto result = horn.solve_fixpoint(equations, n + 1);
+  CPPUNIT_ASSERT(result == newton.solve_fixpoint(equations, n + 1));
+
+  // x_i = x_{i-1} x_{i+1} + x_{i-1}, x_0 = 1, x_{n-1} = x_{n-1}: everything
+  // but the last variable is derived one after the other
+  std::vector<VarId> vars;
+  for (std::size_t i = 0; i < n; ++i) {
+    vars.push_back(Var::GetVarId("horn_chain_x" + std::to_string(i)));
+  }
+  GenericEquations<CommutativePolynomial, BoolSemiring> chain;
+  chain.push_back(std::make_pair(vars[0], CommutativePolynomial<BoolSemiring>{BoolSemiring::one()}));
+  for (std::size_t i = 1; i + 1 < n; ++i) {
+    CommutativePolynomial<BoolSemiring> poly{{BoolSemiring::one(), {vars[i - 1], vars[i + 1]}}};
+    poly += CommutativePolynomial<BoolSemiring>{{BoolSemiring::one(), {vars[i - 1]}}};
+    chain.push_back(std::make_pair(vars[i], poly));
+  }
+  chain.push_back(std::make_pair(vars[n - 1], CommutativePolynomial<BoolSemiring>{
+        {BoolSemiring::one(), {vars[n - 1]}}}));
+  auto chain_result = horn.solve_fixpoint(chain, n + 1);
+  CPPUNIT_ASSERT(horn.GetIterations() == n - 1);
+  for (std::size_t i = 0; i < n; ++i) {
+    CPPUNIT_ASSERT(chain_result.at(vars[i]) == BoolSemiring(i + 1 < n));
+  }
+}
+
+void NewtonTest::testChaoticIteration()
+{
+  // 0 -> 1 -> 2 -> 3 -> 1, 2 -> 2, 3 -> 4: the loop 1 2 3 with head 1
+  // contains the self loop of 2, 0 and 4 are not part of any loop
+  std::vector< std::vector<std::size_t> > successors{{1}, {2}, {2, 3}, {1, 4}, {}};
+  WeakTopologicalOrder wto{successors};
+  CPPUNIT_ASSERT(wto.size() == 5);
+  CPPUNIT_ASSERT(wto.Vertex(0) == 0 && !wto.IsHead(0));
+  CPPUNIT_ASSERT(wto.Vertex(1) == 1 && wto.IsHead(1) && wto.ComponentEnd(1) == 4);
+  CPPUNIT_ASSERT(wto.Vertex(2) == 2 && wto.IsHead(2) && wto.ComponentEnd(2) == 3);
+  CPPUNIT_ASSERT(wto.Vertex(3) == 3 && !wto.IsHead(3));
+  CPPUNIT_ASSERT(wto.Vertex(4) == 4 && !wto.IsHead(4));
+
+  // a cycle far longer than the call stack would allow for a recursive
+  // construction
+  const std::size_t cycle_length = 1000000;
+  std::vector< std::vector<std::size_t> > cycle(cycle_length);
+  for (std::size_t v = 0; v < cycle_length; ++v) {
+    cycle[v].push_back((v + 1) % cycle_length);
+  }
+  WeakTopologicalOrder cycle_wto{cycle};
+  CPPUNIT_ASSERT(cycle_wto.IsHead(0) && cycle_wto.ComponentEnd(0) == cycle_length);
+  CPPUNIT_ASSERT(cycle_wto.Vertex(cycle_length - 1) == cycle_length - 1);
+  CPPUNIT_ASSERT(!cycle_wto.IsHead(cycle_length - 1));
+
+  srand(1993);
+  const std::size_t n = 50;
+  const std::size_t max_iter = 10 * n;
+
+  auto tropical = RandomQuadraticSystem<TropicalSemiring>(
+      "chaotic_trop_x", n, [](int r) { return TropicalSemiring(r); });
+  ChaoticIteration<TropicalSemiring> chaotic;
+  KleeneComm<TropicalSemiring> kleene;
+  NewtonCL<TropicalSemiring> newton;
+  auto result = chaotic.solve_fixpoint(tropical, max_iter);
+  CPPUNIT_ASSERT(result == newton.solve_fixpoint(tropical, n + 1));
+  CPPUNIT_ASSERT(result == kleene.solve_fixpoint(tropical, max_iter));
+  CPPUNIT_ASSERT(chaotic.GetEvaluations() < max_iter * n);
+
+  auto boolean = RandomQuadraticSystem<BoolSemiring>(
+      "chaotic_bool_x", n, [](int) { return BoolSemiring::one(); });
+  ChaoticIteration<BoolSemiring> chaotic_bool;
+  NewtonCL<BoolSemiring> newton_bool;
+  CPPUNIT_ASSERT(chaotic_bool.solve_fixpoint(boolean, max_iter) ==
+                 newton_bool.solve_fixpoint(boolean, n + 1));
+  // every variable changes at most once, so it is evaluated at most once
+  // per variable it depends on (plus once at the beginning)
+  CPPUNIT_ASSERT(chaotic_bool.GetEvaluations() <= 4 * n);
+}
+
+void NewtonTest::testKleeneDirtyTracking()
+{
+  // x_i = x_{i+1} + i+1 for i < n-1, x_{n-1} = 1: the 1 travels down the
+  // chain, after that all the updates are zero
+  const std::size_t n = 10;
+  std::vector<VarId> vars;
+  for (std::size_t i = 0; i < n; ++i) {
+    vars.push_back(Var::GetVarId("kleene_dirty_x" + std::to_string(i)));
+  }
+  GenericEquations<CommutativePolynomial, TropicalSemiring> equations;
+  for (std::size_t i = 0; i + 1 < n; ++i) {
+    CommutativePolynomial<TropicalSemiring> poly{{TropicalSemiring::one(), {vars[i + 1]}}};
+    poly += TropicalSemiring(i + 1);
+    equations.push_back(std::make_pair(vars[i], poly));
+  }
+  equations.push_back(std::make_pair(vars[n - 1], CommutativePolynomial<TropicalSemiring>{
+        TropicalSemiring(1)}));
+
+  const std::size_t max_iter = 100;
+  KleeneComm<TropicalSemiring> kleene;
+  auto result = kleene.solve_fixpoint(equations, max_iter);
+  CPPUNIT_ASSERT(kleene.GetIterations() <= n);
+  for (std::size_t i = 0; i < n; ++i) {
+    CPPUNIT_ASSERT(result.at(vars[i]) == TropicalSemiring(1));
+  }
+}
+
+void NewtonTest::testIsomorphicSccs()
+{
+  // x_k = x_k y_k + z, y_k = x_k + c_k and z = 1, where c_0 = c_1 = 2 and
+  // c_2 = 3: the SCCs of x_0 and x_1 only differ in the names and in the order
+  // of the equations, the one of x_2 has another coefficient
+  const VarId z = Var::GetVarId("iso_z");
+  GenericEquations<CommutativePolynomial, TropicalSemiring> equations;
+  std::vector< GenericEquations<CommutativePolynomial, TropicalSemiring> > sccs(3);
+  for (std::size_t k = 0; k < 3; ++k) {
+    const VarId x = Var::GetVarId("iso_x" + std::to_string(k));
+    const VarId y = Var::GetVarId("iso_y" + std::to_string(k));
+    auto x_eq = std::make_pair(x, CommutativePolynomial<TropicalSemiring>{
+        {TropicalSemiring::one(), {x, y}}, {TropicalSemiring::one(), {z}}});
+    CommutativePolynomial<TropicalSemiring> y_poly{{TropicalSemiring::one(), {x}}};
+    y_poly += TropicalSemiring(k < 2 ? 2 : 3);
+    auto y_eq = std::make_pair(y, y_poly);
+    if (k == 1) {
+      sccs[k] = {y_eq, x_eq};
+    } else {
+      sccs[k] = {x_eq, y_eq};
+    }
+    equations.insert(equations.end(), sccs[k].begin(), sccs[k].end());
+  }
+  equations.push_back(std::make_pair(z, CommutativePolynomial<TropicalSemiring>{
+        TropicalSemiring(1)}));
+
+  typedef SccSolutionCache<TropicalSemiring, CommutativePolynomial> Cache;
+  const auto canonical0 = Cache::Canonicalize(sccs[0]);
+  const auto canonical1 = Cache::Canonicalize(sccs[1]);
+  const auto canonical2 = Cache::Canonicalize(sccs[2]);
+  CPPUNIT_ASSERT(canonical0.key == canonical1.key);
+  CPPUNIT_ASSERT(canonical0.equations == canonical1.equations);
+  CPPUNIT_ASSERT(canonical0.key != canonical2.key);
+
+  // the solution is mapped back to the variables of the other SCC
+  const ValuationMap<TropicalSemiring> z_value{{z, TropicalSemiring(1)}};
+  for (auto &scc : sccs) {
+    for (auto &eq : scc) {
+      eq.second = eq.second.partial_eval(z_value);
+    }
+  }
+  Cache cache;
+  NewtonCLDU<TropicalSemiring> newton;
+  cache.Insert(Cache::Canonicalize(sccs[0]), newton.solve_fixpoint(sccs[0], 3));
+  ValuationMap<TropicalSemiring> reused;
+  CPPUNIT_ASSERT(cache.Find(Cache::Canonicalize(sccs[1]), &reused));
+  CPPUNIT_ASSERT(reused == newton.solve_fixpoint(sccs[1], 3));
+  CPPUNIT_ASSERT(!cache.Find(Cache::Canonicalize(sccs[2]), &reused));
+
+  const auto reference = apply_solver<NewtonCLDU, CommutativePolynomial>(
+      equations, false, false, 0, false);
+  const auto sequential = apply_solver<NewtonCLDU, CommutativePolynomial>(
+      equations, true, false, 0, false);
+  const auto parallel = apply_solver<NewtonCLDU, CommutativePolynomial>(
+      equations, true, false, 0, false, 2);
+  CPPUNIT_ASSERT(sequential == reference);
+  CPPUNIT_ASSERT(parallel == reference);
+}
+
+void NewtonTest::testParallelSccs()
+{
+  // x_k = x_k y_k + z_(k % 2), y_k = x_k + (k + 1) and z_i = i + 1 give two
+  // bottom SCCs and eight independent SCCs on top of them, which all feed
+  // into t = x_0 + ... + x_7
+  GenericEquations<CommutativePolynomial, TropicalSemiring> equations;
+  std::vector<VarId> zs;
+  for (std::size_t i = 0; i < 2; ++i) {
+    zs.push_back(Var::GetVarId("par_z" + std::to_string(i)));
+    equations.push_back(std::make_pair(zs[i],
+        CommutativePolynomial<TropicalSemiring>{TropicalSemiring(i + 1)}));
+  }
+  const VarId t = Var::GetVarId("par_t");
+  CommutativePolynomial<TropicalSemiring> t_poly;
+  for (std::size_t k = 0; k < 8; ++k) {
+    const VarId x = Var::GetVarId("par_x" + std::to_string(k));
+    const VarId y = Var::GetVarId("par_y" + std::to_string(k));
+    equations.push_back(std::make_pair(x, CommutativePolynomial<TropicalSemiring>{
+        {TropicalSemiring::one(), {x, y}}, {TropicalSemiring::one(), {zs[k % 2]}}}));
+    CommutativePolynomial<TropicalSemiring> y_poly{{TropicalSemiring::one(), {x}}};
+    y_poly += TropicalSemiring(k + 1);
+    equations.push_back(std::make_pair(y, y_poly));
+    t_poly += CommutativePolynomial<TropicalSemiring>{{TropicalSemiring::one(), {x}}};
+  }
+  equations.push_back(std::make_pair(t, t_poly));
+
+  const auto sequential = apply_solver<NewtonCLDU, CommutativePolynomial>(
+      equations, true, false, 0, false);
+  CPPUNIT_ASSERT(sequential.size() == equations.size());
+  for (std::size_t threads : {2, 4}) {
+    const auto parallel = apply_solver<NewtonCLDU, CommutativePolynomial>(
+        equations, true, false, 0, false, threads);
+    CPPUNIT_ASSERT(parallel == sequential);
+  }
+}
@@ -0,0 +1,44 @@
+/*
+ * test-newton.h
+ */
+
+#ifndef TEST_NEWTON_H_
+#define TEST_NEWTON_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class NewtonTest : public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(NewtonTest);
+  CPPUNIT_TEST(testIdempotentConvergence);
+  CPPUNIT_TEST(testFloatConvergence);
+  CPPUNIT_TEST(testSymbolicLDU);
+  CPPUNIT_TEST(testParallelEvaluation);
+  CPPUNIT_TEST(testParallelSymbolic);
+  CPPUNIT_TEST(testKnuth);
+  CPPUNIT_TEST(testHorn);
+  CPPUNIT_TEST(testChaoticIteration);
+  CPPUNIT_TEST(testKleeneDirtyTracking);
+  CPPUNIT_TEST(testIsomorphicSccs);
+  CPPUNIT_TEST(testParallelSccs);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void setUp();
+  void tearDown();
+
+protected:
+  void testIdempotentConvergence();
+  void testFloatConvergence();
+  void testSymbolicLDU();
+  void testParallelEvaluation();
+  void testParallelSymbolic();
+  void testKnuth();
+  void testHorn();
+  void testChaoticIteration();
+  void testKleeneDirtyTracking();
+  void testIsomorphicSccs();
+  void testParallelSccs();
+};
+
+#endif /* TEST_NEWTON_H_ */
@@ -237,3 +237,53 @@ void PolynomialTest::testDerivativeBinomAt() {
    */
 }
 
+
+void PolynomialTest::testCompiledEvaluation() {
+  std::vector<VarId> vars = {
+    Var::GetVarId("x"), Var::GetVarId("y"), Var::GetVarId("z")
+  };
+  std::vector<TEST_SR> values = {
+    TEST_SR(Var::GetVarId("a")), TEST_SR(Var::GetVarId("b")), TEST_SR(Var::GetVarId("c"))
+  };
+  std::vector<TEST_SR> updates = {
+    TEST_SR(Var::GetVarId("d")), TEST_SR(Var::GetVarId("e")), TEST_SR(Var::GetVarId("f"))
+  };
+  ValuationMap<TEST_SR> value_map, update_map;
+  for (std::size_t i = 0; i < vars.size(); ++i) {
+    value_map.insert({vars[i], values[i]});
+    update_map.insert({vars[i], updates[i]});
+  }
+
+  std::vector< CommutativePolynomial<TEST_SR> > polys = {
+    *null, *one, *first, *second, *third, *p1
+  };
+  CompiledPolynomialSystem<TEST_SR> compiled{polys, vars};
+  CPPUNIT_ASSERT( compiled.size() == polys.size() );
+
+  for (std::size_t i = 0; i < polys.size(); ++i) {
+    CPPUNIT_ASSERT( compiled.GetDegree(i) == polys[i].get_degree() );
+    CPPUNIT_ASSERT( compiled.eval(i, values) == polys[i].eval(value_map) );
+    CPPUNIT_ASSERT( compiled.AllNewtonDerivatives(i, values, updates) ==
+                    polys[i].AllNewtonDerivatives(value_map, update_map) );
+  }
+
+  // the implicit height unfolding is the same as the constructed one
+  std::vector<TEST_SR> previous = {
+    TEST_SR(Var::GetVarId("g")), TEST_SR(Var::GetVarId("h")), TEST_SR::null()
+  };
+  for (std::size_t i = 0; i < polys.size(); ++i) {
+    SubstitutionMap prev_var_map;
+    SubstitutionMap var_map;
+    auto unfolded = polys[i].HeightUnfolding(prev_var_map, var_map);
+    ValuationMap<TEST_SR> unfolded_values;
+    for (std::size_t j = 0; j < vars.size(); ++j) {
+      unfolded_values.insert({vars[j], updates[j]});
+      if (prev_var_map.count(vars[j])) {
+        unfolded_values.insert({prev_var_map.at(vars[j]), previous[j]});
+        unfolded_values.insert({var_map.at(vars[j]), values[j]});
+      }
+    }
+    CPPUNIT_ASSERT( compiled.EvalHeightUnfolding(i, previous, values, updates) ==
+                    unfolded.eval(unfolded_values) );
+  }
+}
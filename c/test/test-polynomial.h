@@ -9,6 +9,7 @@
 #include "../src/semirings/why-set.h"
 
 #include "../src/polynomials/commutative_polynomial.h"
+#include "../src/polynomials/compiled_polynomial.h"
 #include "../src/datastructs/matrix.h"
 #include "../src/matrix_free_semiring.h"
 
@@ -25,6 +26,7 @@ class PolynomialTest : public CppUnit::TestFixture
 	CPPUNIT_TEST(testEvaluation);
 	CPPUNIT_TEST(testMatrixEvaluation);
 	CPPUNIT_TEST(testDerivativeBinomAt);
+	CPPUNIT_TEST(testCompiledEvaluation);
 //	CPPUNIT_TEST(testPolynomialToFreeSemiring);
 	CPPUNIT_TEST_SUITE_END();
 
@@ -41,6 +43,7 @@ protected:
 	void testMatrixEvaluation();
 	void testPolynomialToFreeSemiring();
 	void testDerivativeBinomAt();
+	void testCompiledEvaluation();
 
 private:
 	TEST_SR *a, *b, *c, *d, *e;
@@ -0,0 +1,90 @@
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "test-thread-pool.h"
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ThreadPoolTest);
+
+void ThreadPoolTest::setUp()
+{
+  std::cout << "ThreadPool-Test :" << std::endl;
+}
+
+void ThreadPoolTest::tearDown()
+{
+}
+
+void ThreadPoolTest::testNestedTasks()
+{
+	ThreadPool pool{4};
+	std::atomic<std::size_t> leaves{0};
+
+	// every task of the outer group spawns a binary tree of tasks in the same
+	// group, and waits for a group of its own
+	TaskGroup outer{pool};
+	std::function<void(std::size_t)> spawn = [&](std::size_t depth) {
+		if (depth == 0) {
+			TaskGroup inner{pool};
+			for (std::size_t i = 0; i < 10; ++i) {
+				inner.Run([&leaves]() { ++leaves; });
+			}
+			inner.Wait();
+			return;
+		}
+		outer.Run([&spawn, depth]() { spawn(depth - 1); });
+		outer.Run([&spawn, depth]() { spawn(depth - 1); });
+	};
+	outer.Run([&spawn]() { spawn(6); });
+	outer.Wait();
+	CPPUNIT_ASSERT(leaves == 10 * 64);
+
+	// waiting for a finished (or empty) group returns at once
+	outer.Wait();
+	TaskGroup empty{pool};
+	empty.Wait();
+}
+
+void ThreadPoolTest::testSingleThread()
+{
+	// no worker threads, the waiting thread runs the tasks, but only the ones
+	// of the group it waits for
+	ThreadPool pool{1};
+	CPPUNIT_ASSERT(pool.GetNumThreads() == 1);
+	bool a_ran = false;
+	bool b_ran = false;
+	TaskGroup a{pool};
+	TaskGroup b{pool};
+	b.Run([&b_ran]() { b_ran = true; });
+	a.Run([&a, &a_ran]() {
+		a.Run([&a_ran]() { a_ran = true; });
+	});
+	a.Wait();
+	CPPUNIT_ASSERT(a_ran);
+	CPPUNIT_ASSERT(!b_ran);
+	b.Wait();
+	CPPUNIT_ASSERT(b_ran);
+}
+
+void ThreadPoolTest::testParallelFor()
+{
+	const std::size_t n = 10000;
+	for (std::size_t threads : {1, 2, 4}) {
+		ThreadPool pool{threads};
+		std::vector<std::size_t> squares(n, 0);
+		ParallelFor(&pool, n, 16, [&squares](std::size_t i) { squares[i] = i * i; });
+		for (std::size_t i = 0; i < n; ++i) {
+			CPPUNIT_ASSERT(squares[i] == i * i);
+		}
+
+		// nested loops, the inner ones wait inside of the tasks of the outer one
+		std::vector<std::atomic<std::size_t>> sums(100);
+		ParallelFor(&pool, sums.size(), 1, [&pool, &sums](std::size_t i) {
+			sums[i] = 0;
+			ParallelFor(&pool, 1000, 10, [&sums, i](std::size_t j) { sums[i] += j; });
+		});
+		for (const auto &sum : sums) {
+			CPPUNIT_ASSERT(sum == 1000 * 999 / 2);
+		}
+	}
+}
@@ -0,0 +1,26 @@
+#ifndef TEST_THREAD_POOL_H
+#define TEST_THREAD_POOL_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "../src/utils/thread_pool.h"
+
+class ThreadPoolTest : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(ThreadPoolTest);
+	CPPUNIT_TEST(testNestedTasks);
+	CPPUNIT_TEST(testSingleThread);
+	CPPUNIT_TEST(testParallelFor);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp();
+	void tearDown();
+
+protected:
+	void testNestedTasks();
+	void testSingleThread();
+	void testParallelFor();
+};
+
+#endif